@@ -1,2 +1,30 @@
+#pragma once
+
+#include <sched.h>
+
 #define STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST)
-#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
\ No newline at end of file
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+
+// what a lock needs: take with acquire, hand over with release
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE_RELEASE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define STORE_RELAXED(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELAXED)
+
+#define CPU_RELAX() __builtin_ia32_pause()
+
+// one round of busy waiting: pause, and once that took long give the cpu away,
+// with more threads than cores the thread we wait for may not be running at all
+#define SPIN_LIMIT 1000
+static inline void spin_wait(unsigned* spins) {
+    if (++*spins < SPIN_LIMIT) {
+        CPU_RELAX();
+    } else {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+// keeps data written by different threads on different lines
+#define CACHE_LINE 64
+#define PADDED _Alignas(CACHE_LINE)
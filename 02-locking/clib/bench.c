@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atomicutils.h"
+#include "peterson_lock.h"
+#include "semaphore_lock.h"
+#include "futex_lock.h"
+#include "futex3_lock.h"
+#include "ticket_lock.h"
+#include "mcs_lock.h"
+#include "clh_lock.h"
+#include "filter_lock.h"
+#include "rw_lock.h"
+#include "seq_lock.h"
+#include "bravo_lock.h"
+
+// Lock scalability benchmark: N threads take the lock for a fixed time, each acquisition
+// does `cs` units of work inside the critical section and `ncs` outside of it.
+// Prints one CSV line: throughput, acquire latency percentiles and how evenly the
+// acquisitions were spread over the threads.
+// With `reads` percent of the acquisitions being reads, reader-writer locks take the read
+// side, exclusive locks don't know the difference.
+// usage: bench <lock> <threads> [cs] [ncs] [ms] [reads] [--header], bench --header prints only the header
+
+// ================ LOCKS =================================
+
+typedef enum {
+    NONE, PETERSON, SEMAPHORE, FUTEX, FUTEX3, TICKET, MCS, CLH, FILTER, RW, SEQ, BRAVO, LOCK_KINDS
+} lock_kind;
+
+const char* lock_names[LOCK_KINDS] = {
+    "none", "peterson", "semaphore", "futex", "futex3", "ticket", "mcs", "clh", "filter", "rw", "seq", "bravo"
+};
+
+typedef struct {
+    lock_kind kind;
+    peterson_lock_t peterson;
+    semaphore_lock_t* semaphore;
+    futex_lock_t futex;
+    futex3_lock_t futex3;
+    ticket_lock_t ticket;
+    mcs_lock_t mcs;
+    clh_lock_t clh;
+    filter_lock_t filter;
+    rw_lock_t rw;
+    seq_lock_t seq;
+    bravo_lock_t bravo;
+} any_lock_t;
+
+void make_any_lock(any_lock_t* l, lock_kind kind, int threads) {
+    l->kind = kind;
+    switch (kind) {
+        case PETERSON: l->peterson = make_peterson_lock(); break;
+        case SEMAPHORE: l->semaphore = make_semaphore_lock(); break;
+        case FUTEX: l->futex = make_futex_lock(); break;
+        case FUTEX3: l->futex3 = make_futex3_lock(); break;
+        case TICKET: l->ticket = make_ticket_lock(); break;
+        case MCS: l->mcs = make_mcs_lock(); break;
+        case CLH: l->clh = make_clh_lock(); break;
+        case FILTER: l->filter = make_filter_lock(threads); break;
+        case RW: l->rw = make_rw_lock(); break;
+        case SEQ: l->seq = make_seq_lock(); break;
+        case BRAVO: l->bravo = make_bravo_lock(); break;
+        default: break;
+    }
+}
+
+void release_any_lock(any_lock_t* l) {
+    switch (l->kind) {
+        case SEMAPHORE: release_semaphore_lock(l->semaphore); break;
+        case CLH: release_clh_lock(&l->clh); break;
+        case FILTER: release_filter_lock(&l->filter); break;
+        case BRAVO: release_bravo_lock(&l->bravo); break;
+        default: break;
+    }
+}
+
+// ================ HISTOGRAM =============================
+
+// HDR style log-linear buckets: exact below 2*SUB, above that every power of two is split
+// into SUB buckets, so a value is off by at most 1/SUB (~3%)
+#define SUB_BITS 5
+#define SUB (1 << SUB_BITS)
+#define BUCKETS ((64 - SUB_BITS) * SUB)
+
+typedef struct {
+    unsigned long count[BUCKETS];
+    unsigned long total;
+    unsigned long max;
+} histogram_t;
+
+int bucket_of(unsigned long v) {
+    if (v < 2 * SUB) return v;
+    int shift = 63 - __builtin_clzl(v) - SUB_BITS;
+    return (shift + 1) * SUB + (int) (v >> shift) - SUB;
+}
+
+// lowest value of the bucket
+unsigned long bucket_value(int b) {
+    if (b < 2 * SUB) return b;
+    int shift = b / SUB - 1;
+    return (unsigned long) (b % SUB + SUB) << shift;
+}
+
+void record(histogram_t* h, unsigned long v) {
+    h->count[bucket_of(v)]++;
+    h->total++;
+    if (v > h->max) h->max = v;
+}
+
+void merge(histogram_t* into, const histogram_t* h) {
+    for (int i = 0; i < BUCKETS; i++) into->count[i] += h->count[i];
+    into->total += h->total;
+    if (h->max > into->max) into->max = h->max;
+}
+
+unsigned long percentile(const histogram_t* h, double p) {
+    unsigned long rank = (unsigned long) (p * h->total);
+    unsigned long seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > rank) return bucket_value(i);
+    }
+    return h->max;
+}
+
+// ================ THREADS ===============================
+
+unsigned long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// work the compiler can't drop or merge
+void spin(unsigned n) {
+    for (unsigned i = 0; i < n; i++) __asm__ volatile("" ::: "memory");
+}
+
+struct {
+    PADDED unsigned long counter;
+    unsigned long data; // counter * cs unless a write is half done
+    PADDED int stop;
+} shared;
+
+// relaxed load and store, not an increment: lost updates mean the lock is broken
+void write_shared(unsigned cs) {
+    STORE_RELAXED(&shared.counter, LOAD_RELAXED(&shared.counter) + 1);
+    for (unsigned i = 0; i < cs; i++) {
+        STORE_RELAXED(&shared.data, LOAD_RELAXED(&shared.data) + 1);
+        spin(1);
+    }
+}
+
+// false if a writer was inside at the same time
+bool read_shared(unsigned cs) {
+    unsigned long counter = LOAD_RELAXED(&shared.counter);
+    spin(cs);
+    return LOAD_RELAXED(&shared.data) == counter * cs;
+}
+
+typedef struct {
+    PADDED any_lock_t* lock;
+    int index;
+    unsigned cs;
+    unsigned ncs;
+    unsigned reads;
+    unsigned random;
+    pthread_barrier_t* start;
+    mcs_node_t node;
+    clh_thread_t clh;
+    int bravo_token;
+    unsigned long ops;
+    unsigned long writes;
+    unsigned long torn_reads;
+    histogram_t latency;
+} thread_state_t;
+
+unsigned next_random(unsigned* x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+void acquire(thread_state_t* t, bool read) {
+    any_lock_t* l = t->lock;
+    switch (l->kind) {
+        case NONE: break;
+        case PETERSON: lock_peterson(&l->peterson, t->index); break;
+        case SEMAPHORE: lock_semaphore(l->semaphore); break;
+        case FUTEX: lock_futex_lock(&l->futex); break;
+        case FUTEX3: lock_futex3_lock(&l->futex3); break;
+        case TICKET: lock_ticket_lock(&l->ticket); break;
+        case MCS: lock_mcs_lock(&l->mcs, &t->node); break;
+        case CLH: lock_clh_lock(&l->clh, &t->clh); break;
+        case FILTER: lock_filter_lock(&l->filter, t->index); break;
+        case RW:
+            if (read) read_lock_rw_lock(&l->rw);
+            else write_lock_rw_lock(&l->rw);
+            break;
+        case SEQ: write_lock_seq_lock(&l->seq); break; // readers don't lock
+        case BRAVO:
+            if (read) t->bravo_token = read_lock_bravo_lock(&l->bravo);
+            else write_lock_bravo_lock(&l->bravo);
+            break;
+        default: break;
+    }
+}
+
+void release(thread_state_t* t, bool read) {
+    any_lock_t* l = t->lock;
+    switch (l->kind) {
+        case NONE: break;
+        case PETERSON: unlock_peterson(&l->peterson, t->index); break;
+        case SEMAPHORE: unlock_semaphore(l->semaphore); break;
+        case FUTEX: unlock_futex_lock(&l->futex); break;
+        case FUTEX3: unlock_futex3_lock(&l->futex3); break;
+        case TICKET: unlock_ticket_lock(&l->ticket); break;
+        case MCS: unlock_mcs_lock(&l->mcs, &t->node); break;
+        case CLH: unlock_clh_lock(&l->clh, &t->clh); break;
+        case FILTER: unlock_filter_lock(&l->filter, t->index); break;
+        case RW:
+            if (read) read_unlock_rw_lock(&l->rw);
+            else write_unlock_rw_lock(&l->rw);
+            break;
+        case SEQ: write_unlock_seq_lock(&l->seq); break;
+        case BRAVO:
+            if (read) read_unlock_bravo_lock(&l->bravo, t->bravo_token);
+            else write_unlock_bravo_lock(&l->bravo);
+            break;
+        default: break;
+    }
+}
+
+void* run(void* raw) {
+    thread_state_t* t = raw;
+    seq_lock_t* seq = &t->lock->seq;
+    bool seq_reads = t->lock->kind == SEQ;
+    if (t->lock->kind == CLH) t->clh = make_clh_thread();
+    pthread_barrier_wait(t->start);
+
+    while (!LOAD_RELAXED(&shared.stop)) {
+        bool read = t->reads > 0 && next_random(&t->random) % 100 < t->reads;
+        unsigned long begin = now_ns();
+        if (read && seq_reads) {
+            // latency up to the attempt that went through
+            unsigned long entered;
+            unsigned start;
+            bool consistent;
+            do {
+                start = read_begin_seq_lock(seq);
+                entered = now_ns();
+                consistent = read_shared(t->cs);
+            } while (read_retry_seq_lock(seq, start));
+            record(&t->latency, entered - begin);
+            if (!consistent) t->torn_reads++;
+        } else {
+            acquire(t, read);
+            record(&t->latency, now_ns() - begin);
+            if (!read) write_shared(t->cs);
+            else if (!read_shared(t->cs)) t->torn_reads++;
+            release(t, read);
+        }
+        if (!read) t->writes++;
+        t->ops++;
+        spin(t->ncs);
+    }
+
+    if (t->lock->kind == CLH) release_clh_thread(&t->clh);
+    return NULL;
+}
+
+// =======================================================
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[argc - 1], "--header") == 0) {
+        puts("lock,threads,cs,ncs,ops,ops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,"
+             "min_thread_ops,max_thread_ops,fairness_cv,reads,ok");
+        if (--argc == 1) return 0;
+    }
+    if (argc < 3) {
+        fprintf(stderr, "usage: bench <lock> <threads> [cs] [ncs] [ms] [reads] [--header]\n");
+        return 1;
+    }
+    lock_kind kind = LOCK_KINDS;
+    for (int i = 0; i < LOCK_KINDS; i++) {
+        if (strcmp(argv[1], lock_names[i]) == 0) kind = i;
+    }
+    int threads = atoi(argv[2]);
+    unsigned cs = argc > 3 ? atoi(argv[3]) : 10;
+    unsigned ncs = argc > 4 ? atoi(argv[4]) : 100;
+    int ms = argc > 5 ? atoi(argv[5]) : 500;
+    unsigned reads = argc > 6 ? atoi(argv[6]) : 0;
+    if (kind == LOCK_KINDS || threads < 1) {
+        fprintf(stderr, "unknown lock %s or bad thread count\n", argv[1]);
+        return 1;
+    }
+    if (kind == PETERSON && threads > 2) {
+        fprintf(stderr, "peterson lock is for two threads\n");
+        return 1;
+    }
+
+    any_lock_t lock;
+    make_any_lock(&lock, kind, threads);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    thread_state_t* states = aligned_alloc(CACHE_LINE, threads * sizeof(thread_state_t));
+    memset(states, 0, threads * sizeof(thread_state_t));
+
+    for (int i = 0; i < threads; i++) {
+        states[i].lock = &lock;
+        states[i].index = i;
+        states[i].cs = cs;
+        states[i].ncs = ncs;
+        states[i].reads = reads;
+        states[i].random = i + 1;
+        states[i].start = &start;
+        pthread_create(&ids[i], NULL, run, &states[i]);
+    }
+    pthread_barrier_wait(&start);
+    unsigned long begin = now_ns();
+    usleep(ms * 1000);
+    STORE(&shared.stop, 1);
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    double seconds = (now_ns() - begin) / 1e9;
+
+    histogram_t* all = calloc(1, sizeof(histogram_t));
+    unsigned long ops = 0, min_ops = -1, max_ops = 0, writes = 0, torn_reads = 0;
+    for (int i = 0; i < threads; i++) {
+        merge(all, &states[i].latency);
+        ops += states[i].ops;
+        writes += states[i].writes;
+        torn_reads += states[i].torn_reads;
+        if (states[i].ops < min_ops) min_ops = states[i].ops;
+        if (states[i].ops > max_ops) max_ops = states[i].ops;
+    }
+    // coefficient of variation of per thread acquisitions, 0 is perfectly fair
+    double mean = (double) ops / threads, var = 0;
+    for (int i = 0; i < threads; i++) var += (states[i].ops - mean) * (states[i].ops - mean);
+    double cv = mean > 0 ? sqrt(var / threads) / mean : 0;
+    bool ok = shared.counter == writes && shared.data == writes * cs && torn_reads == 0;
+
+    printf("%s,%d,%u,%u,%lu,%.0f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.3f,%u,%d\n",
+           lock_names[kind], threads, cs, ncs, ops, ops / seconds,
+           percentile(all, 0.5), percentile(all, 0.9), percentile(all, 0.99), percentile(all, 0.999),
+           all->max, min_ops, max_ops, cv, reads, ok);
+
+    release_any_lock(&lock);
+    pthread_barrier_destroy(&start);
+    free(all);
+    free(states);
+    free(ids);
+    return 0;
+}
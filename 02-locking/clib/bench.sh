@@ -0,0 +1,19 @@
+#!/bin/bash
+cd "$(dirname "$0")"
+# every lock from 1 to 64 threads as CSV, e.g. ./bench.sh 10 100 500 > results.csv
+# arguments: critical section work, work between acquisitions, milliseconds per run,
+# percent of reads, ./bench.sh 10 100 500 99 is the read mostly case
+CS=${1:-10}
+NCS=${2:-100}
+MS=${3:-500}
+READS=${4:-0}
+gcc -O2 bench.c peterson_lock.c semaphore_lock.c futex_lock.c futex3_lock.c \
+    ticket_lock.c mcs_lock.c clh_lock.c filter_lock.c rw_lock.c seq_lock.c bravo_lock.c -lpthread -lm -o bench || exit 1
+./bench --header
+for lock in none peterson semaphore futex futex3 ticket mcs clh filter rw seq bravo; do
+    for threads in 1 2 4 8 16 32 64; do
+        [ $lock = peterson ] && [ $threads -gt 2 ] && continue
+        ./bench $lock $threads $CS $NCS $MS $READS
+    done
+done
+rm -rf bench
@@ -0,0 +1,67 @@
+#define _GNU_SOURCE
+#include "bravo_lock.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// bias stays off for this many revocation times
+#define INHIBIT_FACTOR 9
+
+static unsigned long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+bravo_lock_t make_bravo_lock() {
+    int n = sysconf(_SC_NPROCESSORS_CONF);
+    bravo_slot_t* slots = aligned_alloc(CACHE_LINE, n * sizeof(bravo_slot_t));
+    for (int i = 0; i < n; i++) slots[i].readers = 0;
+    return (bravo_lock_t){1, 0, make_rw_lock(), n, slots};
+}
+
+void release_bravo_lock(bravo_lock_t* lock) {
+    free(lock->slots);
+}
+
+int read_lock_bravo_lock(bravo_lock_t* lock) {
+    if (LOAD_RELAXED(&lock->bias)) {
+        int slot = sched_getcpu() % lock->slot_count;
+        // announce first, then check the bias: a writer stores the bias, then reads the
+        // counters, so one of the two sees the other
+        __atomic_fetch_add(&lock->slots[slot].readers, 1, __ATOMIC_SEQ_CST);
+        if (LOAD(&lock->bias)) return slot;
+        __atomic_fetch_sub(&lock->slots[slot].readers, 1, __ATOMIC_RELEASE);
+    }
+    read_lock_rw_lock(&lock->underlying);
+    // no writer can be inside now, safe to turn the bias back on
+    if (!LOAD_RELAXED(&lock->bias) && now_ns() >= LOAD_RELAXED(&lock->inhibit_until)) {
+        STORE(&lock->bias, 1);
+    }
+    return -1;
+}
+
+void read_unlock_bravo_lock(bravo_lock_t* lock, int token) {
+    if (token >= 0) __atomic_fetch_sub(&lock->slots[token].readers, 1, __ATOMIC_RELEASE);
+    else read_unlock_rw_lock(&lock->underlying);
+}
+
+void write_lock_bravo_lock(bravo_lock_t* lock) {
+    write_lock_rw_lock(&lock->underlying);
+    if (LOAD_RELAXED(&lock->bias)) {
+        unsigned long start = now_ns();
+        STORE(&lock->bias, 0);
+        for (int i = 0; i < lock->slot_count; i++) {
+            unsigned spins = 0;
+            while (LOAD_ACQUIRE(&lock->slots[i].readers) != 0) spin_wait(&spins);
+        }
+        unsigned long end = now_ns();
+        STORE_RELAXED(&lock->inhibit_until, end + (end - start) * INHIBIT_FACTOR);
+    }
+}
+
+void write_unlock_bravo_lock(bravo_lock_t* lock) {
+    write_unlock_rw_lock(&lock->underlying);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "atomicutils.h"
+#include "rw_lock.h"
+
+// BRAVO (Dice, Kogan): a reader-writer lock with a biased fast path for readers.
+// While the lock is read biased readers only bump a counter on the line of their cpu, so
+// reads on different cores share nothing. A writer revokes the bias and waits for the
+// counters to drain, then the underlying rw_lock does the work. Revoking is slow, so the
+// bias comes back only after a while, proportional to how long the revocation took
+typedef struct {
+    PADDED int readers;
+} bravo_slot_t;
+
+typedef struct {
+    PADDED int bias;
+    unsigned long inhibit_until; // ns, no bias before that
+    rw_lock_t underlying;
+    int slot_count;
+    bravo_slot_t* slots; // per cpu
+} bravo_lock_t;
+
+bravo_lock_t make_bravo_lock();
+void release_bravo_lock(bravo_lock_t*);
+// returns what read_unlock needs: the slot taken, or -1 for the slow path
+int read_lock_bravo_lock(bravo_lock_t*);
+void read_unlock_bravo_lock(bravo_lock_t*, int token);
+void write_lock_bravo_lock(bravo_lock_t*);
+void write_unlock_bravo_lock(bravo_lock_t*);
@@ -0,0 +1,40 @@
+#include "clh_lock.h"
+
+#include <stdlib.h>
+
+static clh_node_t* make_node() {
+    clh_node_t* node = aligned_alloc(CACHE_LINE, sizeof(clh_node_t));
+    node->locked = 0;
+    return node;
+}
+
+clh_lock_t make_clh_lock() {
+    return (clh_lock_t){make_node()};
+}
+
+void release_clh_lock(clh_lock_t* lock) {
+    free(lock->tail);
+}
+
+clh_thread_t make_clh_thread() {
+    return (clh_thread_t){make_node(), NULL};
+}
+
+void release_clh_thread(clh_thread_t* thread) {
+    free(thread->node);
+}
+
+void lock_clh_lock(clh_lock_t* lock, clh_thread_t* thread) {
+    STORE_RELAXED(&thread->node->locked, 1);
+    clh_node_t* pred = __atomic_exchange_n(&lock->tail, thread->node, __ATOMIC_ACQ_REL);
+    unsigned spins = 0;
+    while (LOAD_ACQUIRE(&pred->locked)) spin_wait(&spins);
+    thread->pred = pred;
+}
+
+void unlock_clh_lock(clh_lock_t* lock, clh_thread_t* thread) {
+    (void) lock; // the thread's own node is enough
+    clh_node_t* node = thread->node;
+    thread->node = thread->pred; // nobody looks at it anymore
+    STORE_RELEASE(&node->locked, 0);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "atomicutils.h"
+
+// Queue lock of Craig, Landin and Hagersten: a waiter spins on its predecessor's node.
+// On unlock a thread leaves its node to the successor and keeps the predecessor's one,
+// so each thread needs a handle holding one node, plus one node owned by the lock
+typedef struct {
+    PADDED int locked;
+} clh_node_t;
+
+typedef struct {
+    PADDED clh_node_t* tail;
+} clh_lock_t;
+
+typedef struct {
+    clh_node_t* node;
+    clh_node_t* pred;
+} clh_thread_t;
+
+clh_lock_t make_clh_lock();
+// the lock must be free
+void release_clh_lock(clh_lock_t*);
+clh_thread_t make_clh_thread();
+void release_clh_thread(clh_thread_t*);
+void lock_clh_lock(clh_lock_t*, clh_thread_t*);
+void unlock_clh_lock(clh_lock_t*, clh_thread_t*);
@@ -0,0 +1,46 @@
+#include "filter_lock.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+filter_lock_t make_filter_lock(int n) {
+    filter_lock_t lock = {
+        .n = n,
+        .level = aligned_alloc(CACHE_LINE, n * sizeof(filter_slot_t)),
+        .victim = aligned_alloc(CACHE_LINE, n * sizeof(filter_slot_t))
+    };
+    for (int i = 0; i < n; i++) {
+        lock.level[i].value = 0;
+        lock.victim[i].value = -1;
+    }
+    return lock;
+}
+
+void release_filter_lock(filter_lock_t* lock) {
+    free(lock->level);
+    free(lock->victim);
+}
+
+static bool others_at(filter_lock_t* lock, int index, int level) {
+    for (int k = 0; k < lock->n; k++) {
+        if (k != index && LOAD(&lock->level[k].value) >= level) return true;
+    }
+    return false;
+}
+
+void lock_filter_lock(filter_lock_t* lock, int index) {
+    // the store of our level has to be visible before we look at the others (store-load),
+    // this is the one place that needs seq_cst
+    for (int level = 1; level < lock->n; level++) {
+        STORE(&lock->level[index].value, level);
+        STORE(&lock->victim[level].value, index);
+        unsigned spins = 0;
+        while (others_at(lock, index, level) && LOAD(&lock->victim[level].value) == index) {
+            spin_wait(&spins);
+        }
+    }
+}
+
+void unlock_filter_lock(filter_lock_t* lock, int index) {
+    STORE_RELEASE(&lock->level[index].value, 0);
+}
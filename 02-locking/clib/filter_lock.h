@@ -0,0 +1,20 @@
+#pragma once
+
+#include "atomicutils.h"
+
+// Peterson's lock for n threads: n - 1 levels, each one lets all but one thread through.
+// Threads are numbered 0..n-1
+typedef struct {
+    PADDED int value;
+} filter_slot_t;
+
+typedef struct {
+    int n;
+    filter_slot_t* level;  // per thread
+    filter_slot_t* victim; // per level
+} filter_lock_t;
+
+filter_lock_t make_filter_lock(int n);
+void release_filter_lock(filter_lock_t*);
+void lock_filter_lock(filter_lock_t*, int index);
+void unlock_filter_lock(filter_lock_t*, int index);
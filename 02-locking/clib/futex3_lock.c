@@ -0,0 +1,61 @@
+#include "futex3_lock.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define MAX_SPINS 100
+
+long futex3_lock_syscalls = 0;
+
+static void futex(int* addr, int op, int value) {
+    __atomic_fetch_add(&futex3_lock_syscalls, 1, __ATOMIC_RELAXED);
+    syscall(SYS_futex, addr, op | FUTEX_PRIVATE_FLAG, value, 0, 0, 0);
+}
+
+static int cas(int* addr, int expected, int desired) {
+    __atomic_compare_exchange_n(addr, &expected, desired,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expected;
+}
+
+futex3_lock_t make_futex3_lock() {
+    return (futex3_lock_t){0, 0};
+}
+
+void lock_futex3_lock(futex3_lock_t* lock) {
+    int c = cas(&lock->state, 0, 1);
+    if (c == 0) return;
+
+    // spin a while before sleeping, longer when it paid off recently (glibc's adaptive mutex)
+    int spins = __atomic_load_n(&lock->spins, __ATOMIC_RELAXED);
+    int limit = spins * 2 + 10;
+    if (limit > MAX_SPINS) limit = MAX_SPINS;
+    for (int i = 0; i < limit; i++) {
+        // only try when it looks free, a failing cas still takes the line exclusive
+        if (__atomic_load_n(&lock->state, __ATOMIC_RELAXED) == 0) {
+            c = cas(&lock->state, 0, 1);
+            if (c == 0) {
+                __atomic_store_n(&lock->spins, spins + (i - spins) / 8, __ATOMIC_RELAXED);
+                return;
+            }
+        }
+        __builtin_ia32_pause();
+    }
+    __atomic_store_n(&lock->spins, spins + (limit - spins) / 8, __ATOMIC_RELAXED);
+
+    // from here on the lock is marked contended, whoever unlocks it wakes somebody
+    if (c != 2) c = __atomic_exchange_n(&lock->state, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+        futex(&lock->state, FUTEX_WAIT, 2);
+        c = __atomic_exchange_n(&lock->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+void unlock_futex3_lock(futex3_lock_t* lock) {
+    // 1 -> 0 means nobody waits, no syscall
+    if (__atomic_fetch_sub(&lock->state, 1, __ATOMIC_RELEASE) != 1) {
+        __atomic_store_n(&lock->state, 0, __ATOMIC_RELEASE);
+        futex(&lock->state, FUTEX_WAKE, 1);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Drepper's futex mutex, "Futexes Are Tricky" mutex 2:
+// 0 - unlocked, 1 - locked, 2 - locked and maybe contended
+typedef struct {
+    int state;
+    int spins; // running average of spins needed to get the lock
+} futex3_lock_t;
+
+futex3_lock_t make_futex3_lock();
+void lock_futex3_lock(futex3_lock_t*);
+void unlock_futex3_lock(futex3_lock_t*);
+
+// FUTEX_WAIT + FUTEX_WAKE calls made so far
+extern long futex3_lock_syscalls;
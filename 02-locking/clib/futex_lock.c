@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <stdio.h>
 
+long futex_lock_syscalls = 0;
 
 futex_lock_t make_futex_lock() {
     return (futex_lock_t){0};
@@ -15,6 +16,7 @@ void lock_futex_lock(futex_lock_t* lock) {
     int expected = 0;
     while (!__atomic_compare_exchange_n(&lock->atom, &expected, 1, 
             false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_add(&futex_lock_syscalls, 1, __ATOMIC_RELAXED);
         syscall(SYS_futex, &lock->atom, FUTEX_WAIT, 1, 0, 0, 0);
         expected = 0;
     }
@@ -22,5 +24,6 @@ void lock_futex_lock(futex_lock_t* lock) {
 
 void unlock_futex_lock(futex_lock_t* lock) {
     STORE(&lock->atom, 0);
+    __atomic_fetch_add(&futex_lock_syscalls, 1, __ATOMIC_RELAXED);
     syscall(SYS_futex, &lock->atom, FUTEX_WAKE, 1, 0, 0, 0);
 }
\ No newline at end of file
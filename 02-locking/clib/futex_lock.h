@@ -6,4 +6,7 @@ typedef struct {
 
 futex_lock_t make_futex_lock();
 void lock_futex_lock(futex_lock_t*);
-void unlock_futex_lock(futex_lock_t*);
\ No newline at end of file
+void unlock_futex_lock(futex_lock_t*);
+
+// FUTEX_WAIT + FUTEX_WAKE calls made so far
+extern long futex_lock_syscalls;
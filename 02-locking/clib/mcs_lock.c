@@ -0,0 +1,34 @@
+#include "mcs_lock.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+mcs_lock_t make_mcs_lock() {
+    return (mcs_lock_t){NULL};
+}
+
+void lock_mcs_lock(mcs_lock_t* lock, mcs_node_t* node) {
+    STORE_RELAXED(&node->next, NULL);
+    STORE_RELAXED(&node->locked, 1);
+    mcs_node_t* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (prev == NULL) return;
+    // publishes our node to the predecessor
+    STORE_RELEASE(&prev->next, node);
+    unsigned spins = 0;
+    while (LOAD_ACQUIRE(&node->locked)) spin_wait(&spins);
+}
+
+void unlock_mcs_lock(mcs_lock_t* lock, mcs_node_t* node) {
+    mcs_node_t* next = LOAD_ACQUIRE(&node->next);
+    if (next == NULL) {
+        mcs_node_t* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL,
+                false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // a successor swapped the tail but hasn't linked itself yet
+        unsigned spins = 0;
+        while ((next = LOAD_ACQUIRE(&node->next)) == NULL) spin_wait(&spins);
+    }
+    STORE_RELEASE(&next->locked, 0);
+}
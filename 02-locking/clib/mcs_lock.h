@@ -0,0 +1,19 @@
+#pragma once
+
+#include "atomicutils.h"
+
+// Queue lock of Mellor-Crummey and Scott: every waiter spins on a flag in its own node,
+// the holder hands the lock over by clearing its successor's flag.
+// A node per acquisition, it is free again after unlock
+typedef struct mcs_node {
+    PADDED struct mcs_node* next;
+    int locked;
+} mcs_node_t;
+
+typedef struct {
+    PADDED mcs_node_t* tail;
+} mcs_lock_t;
+
+mcs_lock_t make_mcs_lock();
+void lock_mcs_lock(mcs_lock_t*, mcs_node_t*);
+void unlock_mcs_lock(mcs_lock_t*, mcs_node_t*);
@@ -0,0 +1,77 @@
+#include "rw_lock.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define READERS 0x3fffu       // active readers
+#define WRITER (1u << 14)     // a writer holds the lock
+#define SLEEPERS (1u << 15)   // somebody waits in the kernel, unlocks have to wake
+#define WAITING (1u << 16)    // one waiting writer, counted in the upper bits
+
+static void futex(unsigned* addr, int op, unsigned value) {
+    syscall(SYS_futex, addr, op | FUTEX_PRIVATE_FLAG, value, 0, 0, 0);
+}
+
+static bool cas(unsigned* addr, unsigned* expected, unsigned desired) {
+    return __atomic_compare_exchange_n(addr, expected, desired,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// marks the lock as having sleepers and sleeps while it stays at s
+static void sleep_on(rw_lock_t* lock, unsigned s) {
+    if ((s & SLEEPERS) == 0 && !cas(&lock->state, &s, s | SLEEPERS)) return;
+    futex(&lock->state, FUTEX_WAIT, s | SLEEPERS);
+}
+
+// readers and writers share the futex word, so wake all and let them sort it out
+static void wake_all(rw_lock_t* lock) {
+    futex(&lock->state, FUTEX_WAKE, INT_MAX);
+}
+
+rw_lock_t make_rw_lock() {
+    return (rw_lock_t){0};
+}
+
+void read_lock_rw_lock(rw_lock_t* lock) {
+    unsigned s = LOAD_RELAXED(&lock->state);
+    for (;;) {
+        if ((s & WRITER) == 0 && s < WAITING) {
+            if (cas(&lock->state, &s, s + 1)) return;
+        } else {
+            sleep_on(lock, s);
+            s = LOAD_RELAXED(&lock->state);
+        }
+    }
+}
+
+void read_unlock_rw_lock(rw_lock_t* lock) {
+    unsigned s = __atomic_sub_fetch(&lock->state, 1, __ATOMIC_RELEASE);
+    // the last reader lets a writer in
+    while ((s & READERS) == 0 && (s & SLEEPERS)) {
+        if (__atomic_compare_exchange_n(&lock->state, &s, s & ~SLEEPERS,
+                false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            wake_all(lock);
+            return;
+        }
+    }
+}
+
+void write_lock_rw_lock(rw_lock_t* lock) {
+    unsigned s = __atomic_add_fetch(&lock->state, WAITING, __ATOMIC_RELAXED);
+    for (;;) {
+        if ((s & (READERS | WRITER)) == 0) {
+            if (cas(&lock->state, &s, s - WAITING + WRITER)) return;
+        } else {
+            sleep_on(lock, s);
+            s = LOAD_RELAXED(&lock->state);
+        }
+    }
+}
+
+void write_unlock_rw_lock(rw_lock_t* lock) {
+    unsigned s = __atomic_fetch_and(&lock->state, ~(WRITER | SLEEPERS), __ATOMIC_RELEASE);
+    if (s & SLEEPERS) wake_all(lock);
+}
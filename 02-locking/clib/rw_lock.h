@@ -0,0 +1,15 @@
+#pragma once
+
+#include "atomicutils.h"
+
+// Reader-writer futex lock preferring writers: once a writer waits, new readers wait too.
+// One word: active readers, a writer bit, a sleepers bit and the number of waiting writers
+typedef struct {
+    PADDED unsigned state;
+} rw_lock_t;
+
+rw_lock_t make_rw_lock();
+void read_lock_rw_lock(rw_lock_t*);
+void read_unlock_rw_lock(rw_lock_t*);
+void write_lock_rw_lock(rw_lock_t*);
+void write_unlock_rw_lock(rw_lock_t*);
@@ -3,7 +3,7 @@
 #include "stdbool.h"
 
 semaphore_lock_t* make_semaphore_lock() {
-    sem_t* sem = malloc(sizeof(sem));
+    sem_t* sem = malloc(sizeof(*sem));
     sem_init(sem, false, 1);
     return sem;
 }
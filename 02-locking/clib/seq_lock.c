@@ -0,0 +1,36 @@
+#include "seq_lock.h"
+
+seq_lock_t make_seq_lock() {
+    return (seq_lock_t){0};
+}
+
+void write_lock_seq_lock(seq_lock_t* lock) {
+    unsigned spins = 0;
+    unsigned s = LOAD_RELAXED(&lock->seq);
+    for (;;) {
+        // even and ours: the counter doubles as the writers' spin lock
+        if ((s & 1) == 0 && __atomic_compare_exchange_n(&lock->seq, &s, s + 1,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+        spin_wait(&spins);
+        s = LOAD_RELAXED(&lock->seq);
+    }
+    // the odd counter is visible before any of the data stores
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void write_unlock_seq_lock(seq_lock_t* lock) {
+    STORE_RELEASE(&lock->seq, LOAD_RELAXED(&lock->seq) + 1);
+}
+
+unsigned read_begin_seq_lock(seq_lock_t* lock) {
+    unsigned spins = 0;
+    unsigned s;
+    while ((s = LOAD_ACQUIRE(&lock->seq)) & 1) spin_wait(&spins);
+    return s;
+}
+
+bool read_retry_seq_lock(seq_lock_t* lock, unsigned begin) {
+    // the data loads happen before the second look at the counter
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return LOAD_RELAXED(&lock->seq) != begin;
+}
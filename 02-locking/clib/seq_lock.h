@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "atomicutils.h"
+
+// Sequence lock: writers make the counter odd while they write, readers take no lock at
+// all and retry if the counter changed under them. Readers never write shared memory,
+// but may see torn data before the retry check, so they copy it with relaxed atomics
+// and look at it only after read_retry_seq_lock said it was consistent
+typedef struct {
+    PADDED unsigned seq;
+} seq_lock_t;
+
+seq_lock_t make_seq_lock();
+void write_lock_seq_lock(seq_lock_t*);
+void write_unlock_seq_lock(seq_lock_t*);
+unsigned read_begin_seq_lock(seq_lock_t*);
+// true if a writer got in since read_begin, the data read has to be thrown away
+bool read_retry_seq_lock(seq_lock_t*, unsigned begin);
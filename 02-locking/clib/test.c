@@ -11,11 +11,33 @@
 #include "peterson_lock.h"
 #include "semaphore_lock.h"
 #include "futex_lock.h"
+#include "futex3_lock.h"
+#include "ticket_lock.h"
+#include "mcs_lock.h"
+#include "clh_lock.h"
+#include "filter_lock.h"
 
 const int TEST_COUNT = 200;
 const int LOOP_COUNT = 500;
 
+// -D THREAD_COUNT=8, peterson works only with two
+#ifndef THREAD_COUNT
+#define THREAD_COUNT 2
+#endif
+
+#if defined(peterson) && THREAD_COUNT != 2
+#error peterson lock is for two threads
+#endif
+
+typedef struct {
+    void* lock;
+    int index;
+} thread_args;
+
+// microseconds inside the critical section, -D SLEEP=0 to measure the lock itself
+#ifndef SLEEP
 #define SLEEP 100
+#endif
 
 int state = 0;
 int counter = 0;
@@ -23,7 +45,7 @@ int counter = 0;
 void crit_1() {
     if (state == 0) counter += 5;
     else counter -= 5;
-#ifdef SLEEP
+#if SLEEP
     usleep(SLEEP);
 #endif
 }
@@ -48,14 +70,8 @@ void* no_lock(void* args) {
 
 #ifdef peterson
 
-typedef struct  {
-    peterson_lock_t* lock;
-    int index;
-} peterson_args;
-
-int ga = 0;
 void* peterson_lock(void* args_raw) {
-    peterson_args* args = args_raw;
+    thread_args* args = args_raw;
     peterson_lock_t* lock = args->lock;
     int index = args->index;
     for (int i = 0; i < LOOP_COUNT; i++) {
@@ -73,7 +89,7 @@ void* peterson_lock(void* args_raw) {
 #ifdef semaphore
 
 void* semaphore_lock(void* args_raw) {
-    semaphore_lock_t* lock = args_raw;
+    semaphore_lock_t* lock = ((thread_args*) args_raw)->lock;
     for (int i = 0; i < LOOP_COUNT; i++) {
         lock_semaphore(lock);
         crit_1();
@@ -89,7 +105,7 @@ void* semaphore_lock(void* args_raw) {
 #ifdef futex
 
 void* futex_lock(void* args_raw) {
-    futex_lock_t* lock = args_raw;
+    futex_lock_t* lock = ((thread_args*) args_raw)->lock;
     for (int i = 0; i < LOOP_COUNT; i++) {
         lock_futex_lock(lock);
         crit_1();
@@ -100,38 +116,157 @@ void* futex_lock(void* args_raw) {
 
 #endif
 
+// =============== FUTEX3 LOCK ============================
+
+#ifdef futex3
+
+void* futex3_lock(void* args_raw) {
+    futex3_lock_t* lock = ((thread_args*) args_raw)->lock;
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        lock_futex3_lock(lock);
+        crit_1();
+        crit_2();
+        unlock_futex3_lock(lock);
+    }
+}
+
+#endif
+
+// =============== TICKET LOCK ============================
+
+#ifdef ticket
+
+void* ticket_lock(void* args_raw) {
+    ticket_lock_t* lock = ((thread_args*) args_raw)->lock;
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        lock_ticket_lock(lock);
+        crit_1();
+        crit_2();
+        unlock_ticket_lock(lock);
+    }
+}
+
+#endif
+
+// =============== MCS LOCK ===============================
+
+#ifdef mcs
+
+void* mcs_lock(void* args_raw) {
+    mcs_lock_t* lock = ((thread_args*) args_raw)->lock;
+    mcs_node_t node;
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        lock_mcs_lock(lock, &node);
+        crit_1();
+        crit_2();
+        unlock_mcs_lock(lock, &node);
+    }
+}
+
+#endif
+
+// =============== CLH LOCK ===============================
+
+#ifdef clh
+
+void* clh_lock(void* args_raw) {
+    clh_lock_t* lock = ((thread_args*) args_raw)->lock;
+    clh_thread_t self = make_clh_thread();
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        lock_clh_lock(lock, &self);
+        crit_1();
+        crit_2();
+        unlock_clh_lock(lock, &self);
+    }
+    release_clh_thread(&self);
+}
+
+#endif
+
+// =============== FILTER LOCK ============================
+
+#ifdef filter
+
+void* filter_lock(void* args_raw) {
+    thread_args* args = args_raw;
+    filter_lock_t* lock = args->lock;
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        lock_filter_lock(lock, args->index);
+        crit_1();
+        crit_2();
+        unlock_filter_lock(lock, args->index);
+    }
+}
+
+#endif
+
 // =======================================================
 
 bool test() {
     __atomic_store_n(&state, 0, __ATOMIC_SEQ_CST);
     __atomic_store_n(&counter, 0, __ATOMIC_SEQ_CST);
-    pthread_t t1, t2;
+    pthread_t threads[THREAD_COUNT];
+    thread_args args[THREAD_COUNT];
+    void* (*func)(void*);
 #ifdef no
-    pthread_create(&t1, NULL, no_lock, NULL);
-    pthread_create(&t2, NULL, no_lock, NULL);
+    void* lock = NULL;
+    func = no_lock;
 #endif
 #ifdef peterson
-    peterson_lock_t lock = make_peterson_lock();
-    peterson_args args1 = {&lock, 0};
-    peterson_args args2 = {&lock, 1};
-    pthread_create(&t1, NULL, peterson_lock, &args1);
-    pthread_create(&t2, NULL, peterson_lock, &args2);
+    peterson_lock_t lock_value = make_peterson_lock();
+    peterson_lock_t* lock = &lock_value;
+    func = peterson_lock;
 #endif
 #ifdef semaphore
     semaphore_lock_t* lock = make_semaphore_lock();
-    pthread_create(&t1, NULL, semaphore_lock, lock);
-    pthread_create(&t2, NULL, semaphore_lock, lock);
+    func = semaphore_lock;
 #endif
 #ifdef futex
-    futex_lock_t lock = make_futex_lock();
-    pthread_create(&t1, NULL, futex_lock, &lock);
-    pthread_create(&t2, NULL, futex_lock, &lock);
+    futex_lock_t lock_value = make_futex_lock();
+    futex_lock_t* lock = &lock_value;
+    func = futex_lock;
+#endif
+#ifdef futex3
+    futex3_lock_t lock_value = make_futex3_lock();
+    futex3_lock_t* lock = &lock_value;
+    func = futex3_lock;
+#endif
+#ifdef ticket
+    ticket_lock_t lock_value = make_ticket_lock();
+    ticket_lock_t* lock = &lock_value;
+    func = ticket_lock;
+#endif
+#ifdef mcs
+    mcs_lock_t lock_value = make_mcs_lock();
+    mcs_lock_t* lock = &lock_value;
+    func = mcs_lock;
+#endif
+#ifdef clh
+    clh_lock_t lock_value = make_clh_lock();
+    clh_lock_t* lock = &lock_value;
+    func = clh_lock;
 #endif
-    pthread_join(t1, NULL);
-    pthread_join(t2, NULL);
+#ifdef filter
+    filter_lock_t lock_value = make_filter_lock(THREAD_COUNT);
+    filter_lock_t* lock = &lock_value;
+    func = filter_lock;
+#endif
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        args[i] = (thread_args){lock, i};
+        pthread_create(&threads[i], NULL, func, &args[i]);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+    }
 
 #ifdef semaphore
     release_semaphore_lock(lock);
+#endif
+#ifdef clh
+    release_clh_lock(lock);
+#endif
+#ifdef filter
+    release_filter_lock(lock);
 #endif
     return __atomic_load_n(&counter, __ATOMIC_SEQ_CST) == 0;
 }
@@ -158,5 +293,11 @@ int main() {
         }
     }
     printf("Min %f, Max %f \n", mint, maxt);
+#ifdef futex
+    printf("Syscalls %ld \n", futex_lock_syscalls);
+#endif
+#ifdef futex3
+    printf("Syscalls %ld \n", futex3_lock_syscalls);
+#endif
     puts("Passed");
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #!/bin/bash
 cd "$(dirname "$0")"
-gcc test.c $1_lock.c -lpthread -o test -D $1
+# extra arguments go to gcc, e.g. ./test.sh futex3 -D SLEEP=0 -D THREAD_COUNT=4
+gcc test.c $1_lock.c -lpthread -o test -D $1 "${@:2}"
 ./test
 rm -rf test
\ No newline at end of file
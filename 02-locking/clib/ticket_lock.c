@@ -0,0 +1,21 @@
+#include "ticket_lock.h"
+
+ticket_lock_t make_ticket_lock() {
+    return (ticket_lock_t){0, 0};
+}
+
+void lock_ticket_lock(ticket_lock_t* lock) {
+    unsigned mine = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    unsigned spins = 0;
+    for (;;) {
+        unsigned serving = LOAD_ACQUIRE(&lock->serving);
+        if (serving == mine) return;
+        // proportional backoff, everybody ahead of us needs the lock first
+        for (unsigned i = 0; i < (mine - serving); i++) spin_wait(&spins);
+    }
+}
+
+void unlock_ticket_lock(ticket_lock_t* lock) {
+    // only the holder writes serving
+    STORE_RELEASE(&lock->serving, LOAD_RELAXED(&lock->serving) + 1);
+}
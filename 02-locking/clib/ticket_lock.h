@@ -0,0 +1,14 @@
+#pragma once
+
+#include "atomicutils.h"
+
+// FIFO spin lock: take a number, wait until it is served.
+// The counters sit on separate lines, arriving threads don't disturb the holder's line
+typedef struct {
+    PADDED unsigned next;
+    PADDED unsigned serving;
+} ticket_lock_t;
+
+ticket_lock_t make_ticket_lock();
+void lock_ticket_lock(ticket_lock_t*);
+void unlock_ticket_lock(ticket_lock_t*);
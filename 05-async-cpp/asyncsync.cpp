@@ -0,0 +1,137 @@
+#include "asyncsync.hpp"
+
+using Task = ThreadPool::Task;
+
+// ================ MUTEX =================================
+
+bool AsyncMutex::LockAwaiter::await_suspend(std::coroutine_handle<> h) {
+    func_ = [h]{ h.resume(); };
+    uintptr_t s = mutex_->state_.load(std::memory_order_relaxed);
+    for(;;) {
+        if (s == kUnlocked) {
+            if (mutex_->state_.compare_exchange_weak(s, kLocked, std::memory_order_acquire,
+                                                     std::memory_order_relaxed)) {
+                return false; // got it after all
+            }
+            continue;
+        }
+        next_ = s == kLocked ? nullptr : reinterpret_cast<Task*>(s);
+        if (mutex_->state_.compare_exchange_weak(s, reinterpret_cast<uintptr_t>(this),
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void AsyncMutex::unlock() {
+    if (waiters_ == nullptr) {
+        uintptr_t s = kLocked;
+        if (state_.compare_exchange_strong(s, kUnlocked, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+            return;
+        }
+        // take the pushed waiters, newest first, and keep them oldest first
+        s = state_.exchange(kLocked, std::memory_order_acquire);
+        auto* pushed = reinterpret_cast<Task*>(s);
+        while (pushed != nullptr) {
+            Task* next = pushed->next_;
+            pushed->next_ = waiters_;
+            waiters_ = pushed;
+            pushed = next;
+        }
+    }
+    // the lock stays taken and passes to the oldest waiter
+    Task* next = waiters_;
+    waiters_ = next->next_;
+    pool_->run(next);
+}
+
+// ================ SEMAPHORE =============================
+
+bool AsyncSemaphore::try_acquire() {
+    uintptr_t s = state_.load(std::memory_order_relaxed);
+    while (is_count(s) && permits(s) > 0) {
+        if (state_.compare_exchange_weak(s, s - 2, std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncSemaphore::Awaiter::await_suspend(std::coroutine_handle<> h) {
+    func_ = [h]{ h.resume(); };
+    auto& state = semaphore_->state_;
+    uintptr_t s = state.load(std::memory_order_relaxed);
+    for(;;) {
+        if (is_count(s) && permits(s) > 0) {
+            if (state.compare_exchange_weak(s, s - 2, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                return false;
+            }
+            continue;
+        }
+        next_ = is_count(s) ? nullptr : reinterpret_cast<Task*>(s);
+        if (state.compare_exchange_weak(s, reinterpret_cast<uintptr_t>(this),
+                                        std::memory_order_release, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void AsyncSemaphore::release(size_t count) {
+    Task* owned = nullptr; // taken off the state word, newest first
+    Task* wake = nullptr;
+    uintptr_t s = state_.load(std::memory_order_relaxed);
+    for(;;) {
+        if (!is_count(s)) {
+            // arrivals are newer than anything we hold
+            if (!state_.compare_exchange_weak(s, kNone, std::memory_order_acquire,
+                                              std::memory_order_relaxed)) {
+                continue;
+            }
+            auto* arrived = reinterpret_cast<Task*>(s);
+            Task* tail = arrived;
+            while (tail->next_ != nullptr) tail = tail->next_;
+            tail->next_ = owned;
+            owned = arrived;
+            s = kNone;
+        }
+        // hand permits straight to the oldest waiters
+        while (count > 0 && owned != nullptr) {
+            Task** oldest = &owned;
+            while ((*oldest)->next_ != nullptr) oldest = &(*oldest)->next_;
+            Task* w = *oldest;
+            *oldest = nullptr;
+            w->next_ = wake;
+            wake = w;
+            count--;
+        }
+        if (count > 0) {
+            // nobody waiting, bank the rest
+            if (state_.compare_exchange_weak(s, s + 2 * count, std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        if (owned == nullptr) break;
+        // permits released by others in the meantime belong to our waiters
+        if (permits(s) > 0) {
+            if (state_.compare_exchange_weak(s, kNone, std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+                count = permits(s);
+                s = kNone;
+            }
+            continue;
+        }
+        // s == kNone, put the rest back
+        if (state_.compare_exchange_weak(s, reinterpret_cast<uintptr_t>(owned),
+                                         std::memory_order_release, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    // resume outside the loop, nothing is held at this point
+    if (wake != nullptr) pool_->run_batch(wake);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+#include "threadpool.hpp"
+
+// Coroutine mutex and semaphore. Neither blocks a thread: a waiter is the awaiter itself,
+// linked through Task::next_ on a lock free stack, and it is resumed on the pool with the
+// lock or permit already handed over, so nothing runs while anything is held.
+
+// FIFO mutex. The state word is unlocked, locked, or the newest waiter pushed by lock().
+// unlock() moves pushed waiters to a private queue that only the holder touches.
+class AsyncMutex {
+public:
+    explicit AsyncMutex(ThreadPool* pool): pool_(pool) {}
+    AsyncMutex(const AsyncMutex&) = delete;
+    AsyncMutex& operator=(const AsyncMutex&) = delete;
+
+    struct LockAwaiter : ThreadPool::Task {
+        AsyncMutex* mutex_;
+        explicit LockAwaiter(AsyncMutex* mutex): mutex_(mutex) {}
+        bool await_ready() { return mutex_->try_lock(); }
+        bool await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+    };
+
+    // unlocks on destruction
+    class Guard {
+    public:
+        explicit Guard(AsyncMutex* mutex): mutex_(mutex) {}
+        Guard(Guard&& o) noexcept : mutex_(std::exchange(o.mutex_, nullptr)) {}
+        Guard(const Guard&) = delete;
+        ~Guard() { if (mutex_ != nullptr) mutex_->unlock(); }
+    private:
+        AsyncMutex* mutex_;
+    };
+
+    struct GuardAwaiter : LockAwaiter {
+        using LockAwaiter::LockAwaiter;
+        Guard await_resume() const noexcept { return Guard(mutex_); }
+    };
+
+    // co_await mutex.lock(); ... mutex.unlock();
+    LockAwaiter lock() { return LockAwaiter(this); }
+    // auto guard = co_await mutex.scoped_lock();
+    GuardAwaiter scoped_lock() { return GuardAwaiter(this); }
+
+    bool try_lock() {
+        uintptr_t expected = kUnlocked;
+        return state_.compare_exchange_strong(expected, kLocked, std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    void unlock();
+
+private:
+    constexpr static uintptr_t kUnlocked = 1;
+    constexpr static uintptr_t kLocked = 0; // and nobody pushed
+
+    ThreadPool* pool_;
+    std::atomic<uintptr_t> state_ = kUnlocked;
+    ThreadPool::Task* waiters_ = nullptr; // oldest first, holder only
+};
+
+// Counting semaphore. The state word holds either a permit count (tagged with the low bit)
+// or, when there are no permits, the stack of waiters. release() takes the whole stack and
+// puts back what it doesn't wake, so there is no pop and no ABA.
+class AsyncSemaphore {
+public:
+    AsyncSemaphore(ThreadPool* pool, size_t permits): pool_(pool), state_(encode(permits)) {}
+    AsyncSemaphore(const AsyncSemaphore&) = delete;
+    AsyncSemaphore& operator=(const AsyncSemaphore&) = delete;
+
+    struct Awaiter : ThreadPool::Task {
+        AsyncSemaphore* semaphore_;
+        explicit Awaiter(AsyncSemaphore* semaphore): semaphore_(semaphore) {}
+        bool await_ready() { return semaphore_->try_acquire(); }
+        bool await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+    };
+
+    // co_await semaphore.acquire()
+    Awaiter acquire() { return Awaiter(this); }
+    bool try_acquire();
+    void release(size_t count = 1);
+
+private:
+    static bool is_count(uintptr_t s) { return s & 1; }
+    static uintptr_t encode(size_t permits) { return (permits << 1) | 1; }
+    static size_t permits(uintptr_t s) { return s >> 1; }
+    constexpr static uintptr_t kNone = 1; // zero permits, no waiters
+
+    ThreadPool* pool_;
+    std::atomic<uintptr_t> state_;
+};
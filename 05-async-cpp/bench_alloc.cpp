@@ -0,0 +1,80 @@
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <coroutine>
+
+#include "threadpool.hpp"
+#include "schedule.hpp"
+#include "sleeper.hpp"
+
+// Counts global allocations while a coroutine hops through the pool, and while it sleeps on
+// a Sleeper. After warm up (coroutine frame, deque growth) a resume must not allocate.
+
+std::atomic<long> allocations;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+constexpr int kWarmup = 1'000;
+constexpr int kResumes = 100'000;
+// 1ms each
+constexpr int kTimerWarmup = 50;
+constexpr int kTimerResumes = 500;
+
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::atomic<long> steady_allocations = -1;
+
+Detached hop(ThreadPool& pool) {
+    for (int i = 0; i < kWarmup; i++) co_await schedule(pool);
+    long before = allocations.load();
+    for (int i = 0; i < kResumes; i++) co_await schedule(pool);
+    steady_allocations.store(allocations.load() - before);
+}
+
+Detached nap(Sleeper& sleeper) {
+    for (int i = 0; i < kTimerWarmup; i++) co_await sleeper.sleep(1);
+    long before = allocations.load();
+    for (int i = 0; i < kTimerResumes; i++) co_await sleeper.sleep(1);
+    steady_allocations.store(allocations.load() - before);
+}
+
+long measure(ThreadPool::Mode mode, bool timers) {
+    ThreadPool pool(ThreadPool::Config{.threads = 2, .mode = mode});
+    Sleeper sleeper(&pool);
+    steady_allocations.store(-1);
+    if (timers) nap(sleeper);
+    else hop(pool);
+    while (steady_allocations.load() < 0) std::this_thread::yield();
+    return steady_allocations.load();
+}
+
+int main() {
+    long shared = measure(ThreadPool::Mode::Shared, false);
+    long stealing = measure(ThreadPool::Mode::WorkStealing, false);
+    std::cout << "allocations per " << kResumes << " resumes: "
+              << "shared " << shared << ", work stealing " << stealing << std::endl;
+    long shared_timers = measure(ThreadPool::Mode::Shared, true);
+    long stealing_timers = measure(ThreadPool::Mode::WorkStealing, true);
+    std::cout << "allocations per " << kTimerResumes << " timer resumes: "
+              << "shared " << shared_timers << ", work stealing " << stealing_timers << std::endl;
+    if (shared != 0 || stealing != 0 || shared_timers != 0 || stealing_timers != 0) {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "Passed" << std::endl;
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <ctime>
+
+#include "threadpool.hpp"
+#include "schedule.hpp"
+#include "task.hpp"
+#include "join.hpp"
+#include "channel.hpp"
+#include "asyncsync.hpp"
+
+// Producer/consumer through a bounded queue:
+//   channel - Channel<long>, producers and consumers are coroutines on the pool
+//   condvar - std::mutex + condition_variable queue, one thread per producer and consumer
+// plus a contended counter under AsyncMutex vs std::mutex.
+// Reports items/sec, the threads involved and cpu time / wall time (cores kept busy).
+// usage: bench_channel [producers] [consumers] [items] [capacity]
+
+using Clock = std::chrono::steady_clock;
+
+double cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Result {
+    double wall;
+    double cpu;
+    bool ok;
+};
+
+template<typename F>
+Result measure(F f) {
+    double cpu = cpu_seconds();
+    auto start = Clock::now();
+    bool ok = f();
+    return {std::chrono::duration<double>(Clock::now() - start).count(), cpu_seconds() - cpu, ok};
+}
+
+void report(const char* name, size_t threads, long items, Result r) {
+    std::cout << std::setw(10) << name
+              << std::setw(6) << threads << " threads"
+              << std::setw(12) << (long)(items / r.wall) << " items/s"
+              << std::setw(8) << r.cpu / r.wall << " cores busy"
+              << (r.ok ? "" : "  FAILED") << std::endl;
+}
+
+// ================ CHANNEL ===============================
+
+Task<void> producer(ThreadPool& pool, Channel<long>& channel, long from, long to) {
+    co_await schedule(pool);
+    for (long i = from; i < to; i++) co_await channel.send(i);
+}
+
+Task<void> consumer(ThreadPool& pool, Channel<long>& channel, std::atomic<long>& sum) {
+    co_await schedule(pool);
+    long local = 0;
+    for(;;) {
+        std::optional<long> value = co_await channel.recv();
+        if (!value) break;
+        local += *value;
+    }
+    sum.fetch_add(local);
+}
+
+Task<void> pipeline(ThreadPool& pool, Channel<long>& channel, int producers, int consumers,
+                    long items, std::atomic<long>& sum) {
+    Nursery readers;
+    for (int i = 0; i < consumers; i++) readers.spawn(consumer(pool, channel, sum));
+    Nursery writers;
+    for (int i = 0; i < producers; i++) {
+        writers.spawn(producer(pool, channel, items * i / producers, items * (i + 1) / producers));
+    }
+    co_await writers.join();
+    channel.close();
+    co_await readers.join();
+}
+
+// ================ CONDVAR ===============================
+
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity): capacity_(capacity) {}
+
+    void push(long value) {
+        std::unique_lock lk(sync_);
+        not_full_.wait(lk, [&]{ return queue_.size() < capacity_; });
+        queue_.push_back(value);
+        not_empty_.notify_one();
+    }
+
+    bool pop(long& value) {
+        std::unique_lock lk(sync_);
+        not_empty_.wait(lk, [&]{ return !queue_.empty() || closed_; });
+        if (queue_.empty()) return false;
+        value = queue_.front();
+        queue_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::scoped_lock lock(sync_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<long> queue_;
+    bool closed_ = false;
+    std::mutex sync_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+bool blocking(int producers, int consumers, long items, size_t capacity, long expected) {
+    BlockingQueue queue(capacity);
+    std::atomic<long> sum = 0;
+    std::vector<std::thread> writers, readers;
+    for (int i = 0; i < consumers; i++) {
+        readers.emplace_back([&]{
+            long local = 0, value;
+            while (queue.pop(value)) local += value;
+            sum.fetch_add(local);
+        });
+    }
+    for (int i = 0; i < producers; i++) {
+        writers.emplace_back([&, i]{
+            for (long v = items * i / producers; v < items * (i + 1) / producers; v++) queue.push(v);
+        });
+    }
+    for (auto& t: writers) t.join();
+    queue.close();
+    for (auto& t: readers) t.join();
+    return sum.load() == expected;
+}
+
+// ================ MUTEX =================================
+
+Task<void> async_increments(ThreadPool& pool, AsyncMutex& mutex, long& counter, long n) {
+    co_await schedule(pool);
+    for (long i = 0; i < n; i++) {
+        auto guard = co_await mutex.scoped_lock();
+        counter++;
+    }
+}
+
+Task<void> async_counter(ThreadPool& pool, AsyncMutex& mutex, long& counter, int workers, long n) {
+    Nursery nursery;
+    for (int i = 0; i < workers; i++) nursery.spawn(async_increments(pool, mutex, counter, n));
+    co_await nursery.join();
+}
+
+int main(int argc, char** argv) {
+    int producers = argc > 1 ? std::stoi(argv[1]) : 16;
+    int consumers = argc > 2 ? std::stoi(argv[2]) : 16;
+    long items = argc > 3 ? std::stol(argv[3]) : 1'000'000;
+    size_t capacity = argc > 4 ? std::stoul(argv[4]) : 64;
+    long expected = items * (items - 1) / 2;
+
+    ThreadPool::Config config;
+    config.mode = ThreadPool::Mode::WorkStealing;
+    ThreadPool pool(config);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << producers << " producers, " << consumers << " consumers, " << items
+              << " items, capacity " << capacity << std::endl;
+    report("channel", pool.thread_count(), items, measure([&]{
+        Channel<long> channel(&pool, capacity);
+        std::atomic<long> sum = 0;
+        sync_wait(pipeline(pool, channel, producers, consumers, items, sum));
+        return sum.load() == expected;
+    }));
+    report("condvar", producers + consumers, items, measure([&]{
+        return blocking(producers, consumers, items, capacity, expected);
+    }));
+
+    int workers = producers + consumers;
+    long increments = items / workers;
+    std::cout << workers << " workers incrementing a counter " << increments << " times each" << std::endl;
+    report("async", pool.thread_count(), workers * increments, measure([&]{
+        AsyncMutex mutex(&pool);
+        long counter = 0;
+        sync_wait(async_counter(pool, mutex, counter, workers, increments));
+        return counter == workers * increments;
+    }));
+    report("std", workers, workers * increments, measure([&]{
+        std::mutex mutex;
+        long counter = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back([&]{
+                for (long j = 0; j < increments; j++) {
+                    std::scoped_lock lock(mutex);
+                    counter++;
+                }
+            });
+        }
+        for (auto& t: threads) t.join();
+        return counter == workers * increments;
+    }));
+}
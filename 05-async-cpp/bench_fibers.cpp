@@ -0,0 +1,158 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <coroutine>
+
+#include "threadpool.hpp"
+#include "schedule.hpp"
+#include "frameallocator.hpp"
+#include "fiber.hpp"
+
+// Context switches/sec and spawn cost of fibers, against std::thread and C++20 coroutines
+//   switch  - raw nasm_switch between two stacks on one thread
+//   fiber   - Fiber::yield, every yield goes through the pool and back
+//   coro    - co_await schedule(pool), the coroutine equivalent of a yield
+//   thread  - two threads ping-ponging over a condition variable
+//   spawn   - start empty fibers / coroutines / threads and wait for all of them
+// usage: bench_fibers [switches] [spawns]
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double seconds(F f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char* name, const char* unit, long n, double time) {
+    std::cout << std::setw(8) << name
+              << std::setw(14) << (long)(n / time) << " " << unit << "/s"
+              << std::setw(10) << time * 1e9 / n << " ns" << std::endl;
+}
+
+void wait_for(std::atomic<long>& counter, long value) {
+    while (counter.load() != value) std::this_thread::yield();
+}
+
+// ================ RAW SWITCH ============================
+
+void* main_rsp;
+void* other_rsp;
+long raw_switches;
+
+void raw_loop(void*, void*) {
+    for(;;) nasm_switch(&other_rsp, main_rsp, nullptr, nullptr);
+}
+
+double raw(long n) {
+    std::vector<char> stack(64 * 1024);
+    auto base = reinterpret_cast<uintptr_t>(stack.data() + stack.size()) & ~uintptr_t(15);
+    other_rsp = nasm_init(reinterpret_cast<void*>(base), raw_loop);
+    return seconds([&]{
+        for (long i = 0; i < n; i++) nasm_switch(&main_rsp, other_rsp, nullptr, nullptr);
+    });
+}
+
+// ================ COROUTINES ============================
+
+struct Eager {
+    struct promise_type : PooledFrame {
+        Eager get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::atomic<long> finished;
+
+Eager rescheduling(ThreadPool& pool, long n) {
+    for (long i = 0; i < n; i++) co_await schedule(pool);
+    finished.fetch_add(1);
+}
+
+Eager empty_coroutine(ThreadPool& pool) {
+    co_await schedule(pool);
+    finished.fetch_add(1, std::memory_order_relaxed);
+}
+
+// ================ THREADS ===============================
+
+double ping_pong(long n) {
+    std::mutex sync;
+    std::condition_variable waker;
+    long turn = 0;
+    auto player = [&](long parity) {
+        std::unique_lock lk(sync);
+        for (long i = parity; i < n; i += 2) {
+            waker.wait(lk, [&]{ return turn == i; });
+            turn++;
+            waker.notify_one();
+        }
+    };
+    return seconds([&]{
+        std::thread a(player, 0), b(player, 1);
+        a.join();
+        b.join();
+    });
+}
+
+int main(int argc, char** argv) {
+    long switches = argc > 1 ? std::stol(argv[1]) : 2'000'000;
+    long spawns = argc > 2 ? std::stol(argv[2]) : 100'000;
+    int fibers = 8;
+
+    ThreadPool::Config config;
+    config.mode = ThreadPool::Mode::WorkStealing;
+    ThreadPool pool(config);
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::cout << "== context switches, " << pool.thread_count() << " workers" << std::endl;
+    // a round trip is two switches
+    report("switch", "switches", 2 * switches, raw(switches));
+    finished.store(0);
+    report("fiber", "yields", switches, seconds([&]{
+        for (int i = 0; i < fibers; i++) {
+            Fiber::spawn(&pool, [n = switches / fibers]{
+                for (long j = 0; j < n; j++) Fiber::yield();
+                finished.fetch_add(1);
+            });
+        }
+        wait_for(finished, fibers);
+    }));
+    finished.store(0);
+    report("coro", "yields", switches, seconds([&]{
+        for (int i = 0; i < fibers; i++) rescheduling(pool, switches / fibers);
+        wait_for(finished, fibers);
+    }));
+    long pings = std::min(switches, 200'000l);
+    report("thread", "switches", pings, ping_pong(pings));
+
+    std::cout << "== spawn and finish" << std::endl;
+    finished.store(0);
+    report("fiber", "spawns", spawns, seconds([&]{
+        for (long i = 0; i < spawns; i++) {
+            Fiber::spawn(&pool, []{ finished.fetch_add(1, std::memory_order_relaxed); });
+        }
+        wait_for(finished, spawns);
+    }));
+    finished.store(0);
+    report("coro", "spawns", spawns, seconds([&]{
+        for (long i = 0; i < spawns; i++) empty_coroutine(pool);
+        wait_for(finished, spawns);
+    }));
+    long threads = std::min(spawns, 10'000l);
+    report("thread", "spawns", threads, seconds([&]{
+        for (long i = 0; i < threads; i++) {
+            std::thread t([]{ finished.fetch_add(1, std::memory_order_relaxed); });
+            t.join();
+        }
+    }));
+}
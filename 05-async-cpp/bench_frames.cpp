@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <coroutine>
+
+#include "threadpool.hpp"
+#include "schedule.hpp"
+#include "frameallocator.hpp"
+
+// Coroutine frames/sec, FrameAllocator vs global operator new
+//   local  - frames created and destroyed on one thread
+//   remote - frames created on the main thread, finished and freed on a pool worker
+// usage: bench_frames [frames]
+
+using Clock = std::chrono::steady_clock;
+
+struct DefaultFrame {};
+
+// lazy, destroyed by the caller
+template<typename Base>
+struct Lazy {
+    struct promise_type : Base {
+        Lazy get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> h_;
+};
+
+// eager, frees itself wherever it finishes
+template<typename Base>
+struct Eager {
+    struct promise_type : Base {
+        Eager get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::atomic<long> finished;
+
+template<typename Base>
+Lazy<Base> local_frame(long* counter) {
+    (*counter)++;
+    co_return;
+}
+
+template<typename Base>
+Eager<Base> remote_frame(ThreadPool& pool) {
+    co_await schedule(pool);
+    finished.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename Base>
+double local(int n) {
+    long counter = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++) {
+        auto f = local_frame<Base>(&counter);
+        f.h_.resume();
+        f.h_.destroy();
+    }
+    double took = std::chrono::duration<double>(Clock::now() - start).count();
+    return counter / took;
+}
+
+template<typename Base>
+double remote(ThreadPool& pool, int n) {
+    finished.store(0);
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++) {
+        remote_frame<Base>(pool);
+        // bounded number of frames in flight
+        while (i - finished.load(std::memory_order_relaxed) > 1024) std::this_thread::yield();
+    }
+    while (finished.load() != n) std::this_thread::yield();
+    double took = std::chrono::duration<double>(Clock::now() - start).count();
+    return n / took;
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1'000'000;
+    ThreadPool pool(ThreadPool::Config{.threads = 2, .mode = ThreadPool::Mode::WorkStealing});
+    std::cout << std::fixed << std::setprecision(2) << "Mframes/s" << std::endl
+              << "  local:  operator new " << local<DefaultFrame>(n) / 1e6
+              << ", pooled " << local<PooledFrame>(n) / 1e6 << std::endl
+              << "  remote: operator new " << remote<DefaultFrame>(pool, n) / 1e6
+              << ", pooled " << remote<PooledFrame>(pool, n) / 1e6 << std::endl;
+}
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "threadpool.hpp"
+#include "fiber.hpp"
+#include "fibersync.hpp"
+
+extern "C" {
+#include "../02-locking/clib/futex_lock.h"
+}
+
+// Lock handoff latency: the time from a holder's unlock to the lock being taken by somebody
+// else. FiberMutex between fibers on the pool vs the futex lock of 02-locking between threads.
+// Every worker yields after unlocking so the lock actually changes hands.
+// Also a FiberCondVar ping-pong between two fibers.
+// usage: bench_parking [workers] [acquisitions per worker]
+
+using Clock = std::chrono::steady_clock;
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// guarded by whichever lock is measured
+struct Handoffs {
+    int owner = -1;
+    int64_t released_at = 0;
+    long counter = 0;
+    std::vector<int64_t> latencies;
+
+    void acquired(int me) {
+        if (owner != -1 && owner != me) latencies.push_back(now() - released_at);
+        owner = me;
+        counter++;
+    }
+    void releasing() { released_at = now(); }
+};
+
+void report(const char* name, Handoffs& h, long expected) {
+    auto& l = h.latencies;
+    std::sort(l.begin(), l.end());
+    auto pct = [&](double p) { return l.empty() ? 0 : l[std::min(l.size() - 1, size_t(p * l.size()))]; };
+    std::cout << std::setw(8) << name
+              << std::setw(9) << l.size() << " handoffs"
+              << "  p50 " << std::setw(7) << pct(0.5) << "ns"
+              << "  p99 " << std::setw(8) << pct(0.99) << "ns"
+              << "  max " << std::setw(9) << (l.empty() ? 0 : l.back()) << "ns"
+              << (h.counter == expected ? "" : "  FAILED") << std::endl;
+}
+
+void wait_for(std::atomic<int>& counter, int value) {
+    while (counter.load() != value) std::this_thread::yield();
+}
+
+int main(int argc, char** argv) {
+    int workers = argc > 1 ? std::stoi(argv[1]) : 4;
+    long n = argc > 2 ? std::stol(argv[2]) : 100'000;
+
+    ThreadPool::Config config;
+    config.mode = ThreadPool::Mode::WorkStealing;
+    ThreadPool pool(config);
+    std::cout << workers << " workers, " << n << " acquisitions each, "
+              << pool.thread_count() << " pool threads" << std::endl;
+
+    {
+        FiberMutex mutex;
+        Handoffs handoffs;
+        handoffs.latencies.reserve(workers * n);
+        std::atomic<int> done = 0;
+        for (int i = 0; i < workers; i++) {
+            Fiber::spawn(&pool, [&, i]{
+                for (long j = 0; j < n; j++) {
+                    mutex.lock();
+                    handoffs.acquired(i);
+                    handoffs.releasing();
+                    mutex.unlock();
+                    Fiber::yield();
+                }
+                done.fetch_add(1);
+            });
+        }
+        wait_for(done, workers);
+        report("fiber", handoffs, workers * n);
+    }
+
+    {
+        futex_lock_t lock = make_futex_lock();
+        Handoffs handoffs;
+        handoffs.latencies.reserve(workers * n);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back([&, i]{
+                for (long j = 0; j < n; j++) {
+                    lock_futex_lock(&lock);
+                    handoffs.acquired(i);
+                    handoffs.releasing();
+                    unlock_futex_lock(&lock);
+                    std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& t: threads) t.join();
+        report("futex", handoffs, workers * n);
+    }
+
+    {
+        // strict alternation, every round trip parks and wakes both sides
+        FiberMutex mutex;
+        FiberCondVar turn_changed;
+        int turn = 0;
+        long rounds = n;
+        std::atomic<int> done = 0;
+        auto start = Clock::now();
+        for (int side = 0; side < 2; side++) {
+            Fiber::spawn(&pool, [&, side]{
+                for (long j = 0; j < rounds; j++) {
+                    mutex.lock();
+                    turn_changed.wait(mutex, [&]{ return turn == side; });
+                    turn = 1 - side;
+                    turn_changed.notify_one();
+                    mutex.unlock();
+                }
+                done.fetch_add(1);
+            });
+        }
+        wait_for(done, 2);
+        double time = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << std::setw(8) << "condvar" << std::setw(9) << rounds << " round trips"
+                  << "  " << (long)(time * 1e9 / rounds) << "ns each" << std::endl;
+    }
+}
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "threadpool.hpp"
+#include "reactor.hpp"
+#include "sleeper.hpp"
+#include "task.hpp"
+
+// Loopback TCP echo: a server coroutine per connection, clients doing write/read round trips.
+// Requests/sec and round trip latency for both reactor backends, then a check that deadlines
+// expire idle reads and accepts and leave answered ones alone, and that async_close ends a
+// read pending on the same socket.
+// usage: bench_reactor [connections] [round trips per connection] [message size]
+
+using Clock = std::chrono::steady_clock;
+
+struct Run {
+    Reactor* reactor;
+    size_t trips;
+    size_t size;
+    std::atomic<int> running = 0;
+    std::atomic<long> failures = 0;
+    std::vector<std::vector<int64_t>> latencies; // ns, one vector per client
+};
+
+int listen_socket(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    listen(fd, 1024);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+int connect_socket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// full buffer or error
+Task<bool> write_all(Reactor& reactor, int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        int64_t n = co_await reactor.async_write(fd, buf, len);
+        if (n <= 0) co_return false;
+        buf += n;
+        len -= n;
+    }
+    co_return true;
+}
+
+Task<bool> read_all(Reactor& reactor, int fd, char* buf, size_t len) {
+    while (len > 0) {
+        int64_t n = co_await reactor.async_read(fd, buf, len);
+        if (n <= 0) co_return false;
+        buf += n;
+        len -= n;
+    }
+    co_return true;
+}
+
+Task<void> echo(Run& run, int fd) {
+    std::vector<char> buf(run.size);
+    for(;;) {
+        int64_t n = co_await run.reactor->async_read(fd, buf.data(), buf.size());
+        if (n <= 0) break;
+        if (!co_await write_all(*run.reactor, fd, buf.data(), n)) break;
+    }
+    co_await run.reactor->async_close(fd);
+    run.running.fetch_sub(1);
+}
+
+Task<void> server(Run& run, int listener, int connections) {
+    for (int i = 0; i < connections; i++) {
+        int64_t fd = co_await run.reactor->async_accept(listener);
+        if (fd < 0) {
+            run.failures.fetch_add(1);
+            run.running.fetch_sub(1);
+            continue;
+        }
+        spawn(echo(run, fd));
+    }
+}
+
+Task<void> client(Run& run, int fd, std::vector<int64_t>& latencies) {
+    std::vector<char> out(run.size, 'x'), in(run.size);
+    for (size_t i = 0; i < run.trips; i++) {
+        auto start = Clock::now();
+        if (!co_await write_all(*run.reactor, fd, out.data(), out.size()) ||
+            !co_await read_all(*run.reactor, fd, in.data(), in.size())) {
+            run.failures.fetch_add(1);
+            break;
+        }
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+    co_await run.reactor->async_close(fd);
+    run.running.fetch_sub(1);
+}
+
+void bench(ThreadPool& pool, Reactor::Backend backend, int connections, size_t trips, size_t size) {
+    Reactor reactor(&pool, backend);
+    Run run;
+    run.reactor = &reactor;
+    run.trips = trips;
+    run.size = size;
+    run.latencies.resize(connections);
+    run.running.store(2 * connections);
+
+    uint16_t port;
+    int listener = listen_socket(port);
+    spawn(server(run, listener, connections));
+    std::vector<int> fds;
+    for (int i = 0; i < connections; i++) fds.push_back(connect_socket(port));
+
+    auto start = Clock::now();
+    for (int i = 0; i < connections; i++) spawn(client(run, fds[i], run.latencies[i]));
+    while (run.running.load() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double time = std::chrono::duration<double>(Clock::now() - start).count();
+    close(listener);
+
+    std::vector<int64_t> all;
+    for (auto& l: run.latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all.empty() ? 0 : all[std::min(all.size() - 1, size_t(p * all.size()))] / 1000.0; };
+
+    const char* name = reactor.backend() == Reactor::Backend::IoUring ? "io_uring" : "epoll";
+    std::cout << std::setw(10) << name
+              << std::setw(12) << (long)(all.size() / time) << " req/s"
+              << "  p50 " << std::setw(8) << pct(0.5) << "us"
+              << "  p99 " << std::setw(8) << pct(0.99) << "us"
+              << (run.failures.load() ? "  FAILED" : "") << std::endl;
+}
+
+struct Deadlines {
+    Reactor* reactor;
+    std::atomic<int> running = 0;
+    std::atomic<long> failures = 0;
+};
+
+Task<void> idle(Deadlines& d, int fd, int listener) {
+    char c;
+    if (co_await d.reactor->async_read(fd, &c, 1, 5) != -ETIMEDOUT) d.failures.fetch_add(1);
+    if (co_await d.reactor->async_accept(listener, 5) != -ETIMEDOUT) d.failures.fetch_add(1);
+    d.running.fetch_sub(1);
+}
+
+Task<void> answered(Deadlines& d, int fd) {
+    char c;
+    if (co_await d.reactor->async_read(fd, &c, 1, 10'000) != 1) d.failures.fetch_add(1);
+    d.running.fetch_sub(1);
+}
+
+// reads racing their deadline against a writer, each comes back once with either result
+Task<void> racing(Deadlines& d, int fd, int n) {
+    char c;
+    for (int i = 0; i < n;) {
+        int64_t r = co_await d.reactor->async_read(fd, &c, 1, 1);
+        if (r == 1) {
+            i++;
+        } else if (r != -ETIMEDOUT) {
+            d.failures.fetch_add(1);
+            break;
+        }
+    }
+    d.running.fetch_sub(1);
+}
+
+void deadlines(ThreadPool& pool, Reactor::Backend backend) {
+    Sleeper sleeper(&pool);
+    Reactor reactor(&pool, sleeper, backend);
+    Deadlines d;
+    d.reactor = &reactor;
+
+    uint16_t port;
+    int listener = listen_socket(port);
+    int idle_fds[2], answered_fds[2], racing_fds[2];
+    for (int* fds: {idle_fds, answered_fds, racing_fds}) socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds);
+
+    d.running.store(3);
+    spawn(idle(d, idle_fds[0], listener));
+    spawn(answered(d, answered_fds[0]));
+    spawn(racing(d, racing_fds[0], 1'000));
+    char c = 'x';
+    for (int i = 0; i < 1'000; i++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(i % 5 * 250));
+        ::write(racing_fds[1], &c, 1);
+    }
+    ::write(answered_fds[1], &c, 1);
+    while (d.running.load() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    for (int* fds: {idle_fds, answered_fds, racing_fds}) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    close(listener);
+    const char* name = reactor.backend() == Reactor::Backend::IoUring ? "io_uring" : "epoll";
+    std::cout << std::setw(10) << name << "  deadlines " << (d.failures.load() ? "FAILED" : "passed") << std::endl;
+}
+
+Task<void> pending_read(Deadlines& d, int fd) {
+    char c;
+    if (co_await d.reactor->async_read(fd, &c, 1) >= 0) d.failures.fetch_add(1);
+    d.running.fetch_sub(1);
+}
+
+Task<void> close_socket(Deadlines& d, int fd) {
+    int64_t result = co_await d.reactor->async_close(fd);
+    if (result != 0) d.failures.fetch_add(1);
+    d.running.fetch_sub(1);
+}
+
+void closing(ThreadPool& pool, Reactor::Backend backend) {
+    Reactor reactor(&pool, backend);
+    Deadlines d;
+    d.reactor = &reactor;
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds);
+    d.running.store(2);
+    spawn(pending_read(d, fds[0]));
+    // let the read reach the loop
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    spawn(close_socket(d, fds[0]));
+    auto start = Clock::now();
+    while (d.running.load() > 0 && Clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool hung = d.running.load() > 0;
+    close(fds[1]);
+    const char* name = reactor.backend() == Reactor::Backend::IoUring ? "io_uring" : "epoll";
+    std::cout << std::setw(10) << name << "  pending close " << (hung ? "HUNG" : d.failures.load() ? "FAILED" : "passed") << std::endl;
+    // a hung read is still on the reactor
+    if (hung) std::exit(1);
+}
+
+int main(int argc, char** argv) {
+    int connections = argc > 1 ? std::stoi(argv[1]) : 32;
+    size_t trips = argc > 2 ? std::stoul(argv[2]) : 5'000;
+    size_t size = argc > 3 ? std::stoul(argv[3]) : 64;
+
+    ThreadPool::Config config;
+    config.mode = ThreadPool::Mode::WorkStealing;
+    ThreadPool pool(config);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << connections << " connections, " << trips << " round trips of " << size << " bytes" << std::endl;
+    bench(pool, Reactor::Backend::Epoll, connections, trips, size);
+    bench(pool, Reactor::Backend::IoUring, connections, trips, size);
+    deadlines(pool, Reactor::Backend::Epoll);
+    deadlines(pool, Reactor::Backend::IoUring);
+    closing(pool, Reactor::Backend::Epoll);
+    closing(pool, Reactor::Backend::IoUring);
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <atomic>
+
+#include "threadpool.hpp"
+#include "sleeper.hpp"
+
+// latency - fire time error: from the deadline to the callback running on the pool
+// cancel  - arm many timers and cancel 99% of them, like request timeouts do
+// arming  - every pool worker arms timers in a loop, sharded vs single shard Sleeper
+// usage: bench_sleeper [latency timers] [cancel timers] [arming threads]
+
+using Clock = std::chrono::steady_clock;
+
+void latency(Sleeper& sleeper, int count) {
+    std::vector<int64_t> error(count);
+    std::atomic<int> fired = 0;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> delay(1, 500);
+
+    for (int i = 0; i < count; i++) {
+        int ms = delay(rng);
+        int64_t deadline = Sleeper::now() + ms * 1'000'000ll;
+        sleeper.run(ms, [&, i, deadline]{
+            error[i] = Sleeper::now() - deadline;
+            fired.fetch_add(1);
+        });
+    }
+    while (fired.load() != count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::sort(error.begin(), error.end());
+    auto pct = [&](double p) {
+        return error[std::min<size_t>(count - 1, p / 100 * count)] / 1000.0;
+    };
+    std::cout << std::fixed << std::setprecision(1)
+              << count << " timers, fire error (us): "
+              << "min " << error.front() / 1000.0
+              << " p50 " << pct(50)
+              << " p90 " << pct(90)
+              << " p99 " << pct(99)
+              << " p99.9 " << pct(99.9)
+              << " max " << error.back() / 1000.0 << std::endl;
+}
+
+void cancellation(Sleeper& sleeper, int count) {
+    std::vector<Sleeper::Handle> handles(count);
+    std::atomic<int> fired = 0;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> delay(2000, 3000);
+
+    auto start = Clock::now();
+    for (int i = 0; i < count; i++) {
+        handles[i] = sleeper.run(delay(rng), [&]{ fired.fetch_add(1); });
+    }
+    auto armed = Clock::now();
+    int cancelled = 0;
+    for (int i = 0; i < count; i++) {
+        if (i % 100 != 0) cancelled += sleeper.cancel(handles[i]);
+    }
+    auto end = Clock::now();
+    while (fired.load() != count - cancelled) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto drained = Clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << std::fixed << std::setprecision(1)
+              << count << " timers, " << cancelled << " cancelled: "
+              << "arm " << ms(armed - start).count() << "ms"
+              << " (" << count / std::chrono::duration<double>(armed - start).count() / 1e6 << "M/s)"
+              << ", cancel " << ms(end - armed).count() << "ms"
+              << " (" << cancelled / std::chrono::duration<double>(end - armed).count() / 1e6 << "M/s)"
+              << ", " << fired.load() << " fired, all done after " << ms(drained - start).count() << "ms"
+              << std::endl;
+}
+
+void arming(size_t threads, bool sharded) {
+    constexpr int kPerThread = 200'000;
+    ThreadPool pool(ThreadPool::Config{.threads = threads, .mode = ThreadPool::Mode::WorkStealing});
+    Sleeper sleeper(&pool, sharded);
+    std::atomic<int> armed = 0;
+    std::atomic<int> fired = 0;
+
+    auto start = Clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        pool.run([&]{
+            for (int i = 0; i < kPerThread; i++) {
+                sleeper.run(1 + i % 20, [&]{ fired.fetch_add(1, std::memory_order_relaxed); });
+            }
+            armed.fetch_add(1);
+        });
+    }
+    while (armed.load() != (int) threads) std::this_thread::yield();
+    auto end = Clock::now();
+    int total = kPerThread * threads;
+    while (fired.load() != total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto drained = Clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << std::fixed << std::setprecision(1)
+              << threads << " threads, " << (sharded ? "sharded  " : "one shard") << ": "
+              << total / std::chrono::duration<double>(end - start).count() / 1e6 << "M arms/s"
+              << ", all fired after " << ms(drained - start).count() << "ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int latency_count = argc > 1 ? std::stoi(argv[1]) : 10'000;
+    int cancel_count = argc > 2 ? std::stoi(argv[2]) : 1'000'000;
+    size_t arming_threads = argc > 3 ? std::stoul(argv[3])
+                                     : std::max(8u, std::thread::hardware_concurrency());
+    {
+        ThreadPool pool;
+        Sleeper sleeper(&pool);
+        latency(sleeper, latency_count);
+        cancellation(sleeper, cancel_count);
+    }
+    arming(arming_threads, false);
+    arming(arming_threads, true);
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+
+#include "threadpool.hpp"
+#include "task.hpp"
+
+// 1M chained awaits with Task<T> against the callback style, where every step is a
+// pool.run(func, then) and the continuation nests in `then`
+// usage: bench_task [awaits]
+
+using Clock = std::chrono::steady_clock;
+
+Task<int> leaf(int i) {
+    co_return i;
+}
+
+Task<long> chain(int n) {
+    long sum = 0;
+    for (int i = 0; i < n; i++) sum += co_await leaf(i);
+    co_return sum;
+}
+
+// every level awaits the next one, resumed by symmetric transfer on the way back up
+Task<long> deep(int depth) {
+    if (depth == 0) co_return 0;
+    co_return 1 + co_await deep(depth - 1);
+}
+
+Task<int> thrower() {
+    throw std::runtime_error("from task");
+    co_return 0;
+}
+
+Task<bool> catcher() {
+    try {
+        co_await thrower();
+    } catch (const std::runtime_error&) {
+        co_return true;
+    }
+    co_return false;
+}
+
+std::atomic_bool callbacks_done;
+
+void callback_step(ThreadPool& pool, int i, int n, long* sum) {
+    pool.run([i, sum]{ *sum += i; }, [&pool, i, n, sum]{
+        if (i + 1 < n) callback_step(pool, i + 1, n, sum);
+        else callbacks_done.store(true);
+    });
+}
+
+template<typename F>
+double seconds(F f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1'000'000;
+    long expected = (long) n * (n - 1) / 2;
+
+    long chained = 0;
+    double chain_time = seconds([&]{ chained = sync_wait(chain(n)); });
+    long depth = 0;
+    double deep_time = seconds([&]{ depth = sync_wait(deep(n)); });
+
+    ThreadPool pool;
+    long callback_sum = 0;
+    double callback_time = seconds([&]{
+        callback_step(pool, 0, n, &callback_sum);
+        while (!callbacks_done.load()) std::this_thread::yield();
+    });
+
+    if (chained != expected || callback_sum != expected || depth != n || !sync_wait(catcher())) {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1)
+              << n << " awaits, Mawaits/s: "
+              << "task loop " << n / chain_time / 1e6
+              << ", task recursion " << n / deep_time / 1e6
+              << ", pool callbacks " << n / callback_time / 1e6 << std::endl;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <string>
+
+#include "threadpool.hpp"
+
+// Tasks/sec for both pool modes from 1 to N workers
+//   external - every task is submitted from the main thread
+//   spawn    - tasks fork children from inside the pool (binary tree)
+// usage: bench_threadpool [max threads] [pin] [numa]
+
+constexpr int kExternalTasks = 200'000;
+constexpr int kSpawnDepth = 17; // 2^18 - 1 tasks
+
+std::atomic<long> done;
+bool pin = false;
+bool numa = false;
+
+void spawn(ThreadPool* pool, int depth) {
+    done.fetch_add(1, std::memory_order_relaxed);
+    if (depth == 0) return;
+    pool->run([pool, depth]{ spawn(pool, depth - 1); });
+    pool->run([pool, depth]{ spawn(pool, depth - 1); });
+}
+
+void wait_for(long count) {
+    while (done.load(std::memory_order_relaxed) != count) {
+        std::this_thread::yield();
+    }
+}
+
+double bench_external(ThreadPool::Mode mode, size_t threads) {
+    ThreadPool pool(ThreadPool::Config{.threads = threads, .mode = mode, .pin = pin, .numa = numa});
+    done.store(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kExternalTasks; i++) {
+        pool.run([]{ done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    wait_for(kExternalTasks);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return kExternalTasks / took.count();
+}
+
+double bench_spawn(ThreadPool::Mode mode, size_t threads) {
+    ThreadPool pool(ThreadPool::Config{.threads = threads, .mode = mode, .pin = pin, .numa = numa});
+    done.store(0);
+    long total = (1l << (kSpawnDepth + 1)) - 1;
+    auto start = std::chrono::steady_clock::now();
+    pool.run([&pool]{ spawn(&pool, kSpawnDepth); });
+    wait_for(total);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return total / took.count();
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1) max_threads = std::stoul(argv[1]);
+    for (int i = 2; i < argc; i++) {
+        if (std::string(argv[i]) == "pin") pin = true;
+        if (std::string(argv[i]) == "numa") numa = true;
+    }
+
+    std::cout << std::setw(8) << "threads"
+              << std::setw(16) << "shared/ext"
+              << std::setw(16) << "steal/ext"
+              << std::setw(16) << "shared/spawn"
+              << std::setw(16) << "steal/spawn" << "   (tasks/sec)" << std::endl;
+    for (size_t t = 1; t <= max_threads; t++) {
+        std::cout << std::setw(8) << t << std::fixed << std::setprecision(0)
+                  << std::setw(16) << bench_external(ThreadPool::Mode::Shared, t)
+                  << std::setw(16) << bench_external(ThreadPool::Mode::WorkStealing, t)
+                  << std::setw(16) << bench_spawn(ThreadPool::Mode::Shared, t)
+                  << std::setw(16) << bench_spawn(ThreadPool::Mode::WorkStealing, t)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <coroutine>
+#include <stop_token>
+#include <type_traits>
+
+// Cancellation travels with the awaiting chain: a task picks up the stop token of the
+// coroutine that awaits it unless it already has one of its own (when_any, Nursery).
+// Awaiters that can give up early (Sleeper::sleep) read it from the awaiting promise.
+
+namespace detail {
+
+struct Cancellable {
+    std::stop_token stop_;
+};
+
+template<typename P>
+std::stop_token stop_token_of(std::coroutine_handle<P> h) {
+    if constexpr (std::is_base_of_v<Cancellable, P>) return h.promise().stop_;
+    else return {};
+}
+
+}
+
+// co_await current_stop_token() -> token of the running task, never suspends
+struct CurrentStopToken {
+    std::stop_token token_;
+    bool await_ready() const noexcept { return false; }
+    template<typename P>
+    bool await_suspend(std::coroutine_handle<P> h) noexcept {
+        token_ = detail::stop_token_of(h);
+        return false;
+    }
+    std::stop_token await_resume() noexcept { return std::move(token_); }
+};
+
+inline CurrentStopToken current_stop_token() {
+    return {};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "asyncsync.hpp"
+#include "task.hpp"
+
+// Bounded MPMC channel for coroutines.
+// Two semaphores count free slots and ready items, so send() waits while the channel is full
+// and recv() while it is empty, without blocking a thread. Values sit in a ring of sequenced
+// cells (Vyukov): a permit guarantees the cell, at worst it waits for the peer that is
+// still in the middle of copying the previous value out or in.
+// close() ends the stream: recv() drains what was sent and then returns nullopt. It must
+// come after the last send() has returned.
+template<typename T>
+class Channel {
+public:
+    Channel(ThreadPool* pool, size_t capacity)
+        : capacity_(capacity), cells_(new Cell[capacity]), slots_(pool, capacity), items_(pool, 0) {
+        for (size_t i = 0; i < capacity; i++) cells_[i].seq_.store(i, std::memory_order_relaxed);
+    }
+
+    // false if the channel is closed
+    Task<bool> send(T value) {
+        if (closed_.load(std::memory_order_relaxed)) co_return false;
+        co_await slots_.acquire();
+        size_t pos = write_pos_.fetch_add(1, std::memory_order_relaxed);
+        Cell& cell = cells_[pos % capacity_];
+        wait(cell, pos);
+        cell.value_.emplace(std::move(value));
+        cell.seq_.store(pos + 1, std::memory_order_release);
+        items_.release();
+        co_return true;
+    }
+
+    Task<std::optional<T>> recv() {
+        co_await items_.acquire();
+        size_t pos = read_pos_.load(std::memory_order_relaxed);
+        do {
+            if (pos >= write_pos_.load(std::memory_order_acquire)) {
+                // the close token, pass it on to the next receiver
+                items_.release();
+                co_return std::nullopt;
+            }
+        } while (!read_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed));
+        Cell& cell = cells_[pos % capacity_];
+        wait(cell, pos + 1);
+        std::optional<T> value = std::move(cell.value_);
+        cell.value_.reset();
+        cell.seq_.store(pos + capacity_, std::memory_order_release);
+        slots_.release();
+        co_return value;
+    }
+
+    void close() {
+        if (!closed_.exchange(true)) items_.release();
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq_;
+        std::optional<T> value_;
+    };
+
+    static void wait(Cell& cell, size_t seq) {
+        while (cell.seq_.load(std::memory_order_acquire) != seq) std::this_thread::yield();
+    }
+
+    size_t capacity_;
+    std::unique_ptr<Cell[]> cells_;
+    AsyncSemaphore slots_;
+    AsyncSemaphore items_;
+    alignas(64) std::atomic<size_t> write_pos_ = 0;
+    alignas(64) std::atomic<size_t> read_pos_ = 0;
+    std::atomic_bool closed_ = false;
+};
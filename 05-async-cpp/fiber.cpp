@@ -0,0 +1,168 @@
+#include "fiber.hpp"
+
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <new>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+// ================ STACKS ================================
+
+const size_t kPageSize = sysconf(_SC_PAGESIZE);
+// guard page at the low end, stacks grow down into it and fault
+const size_t kMappingSize = Fiber::kStackSize + kPageSize;
+
+void* map_stack() {
+    void* mem = mmap(nullptr, kMappingSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (mem == MAP_FAILED) throw std::bad_alloc();
+    if (mprotect(mem, kPageSize, PROT_NONE) != 0) {
+        munmap(mem, kMappingSize);
+        throw std::bad_alloc();
+    }
+    return mem;
+}
+
+// a few stacks per thread, the rest shared
+constexpr size_t kCachedStacks = 16;
+constexpr size_t kPooledStacks = 1024;
+
+std::mutex pool_sync;
+std::vector<void*>& pooled = *new std::vector<void*>(); // never destroyed, see FrameAllocator
+
+struct StackCache {
+    std::vector<void*> stacks_;
+    ~StackCache() {
+        std::scoped_lock lock(pool_sync);
+        for (void* s: stacks_) pooled.push_back(s);
+    }
+};
+
+thread_local StackCache stack_cache;
+
+void* acquire_stack() {
+    auto& local = stack_cache.stacks_;
+    if (local.empty()) {
+        std::scoped_lock lock(pool_sync);
+        // refill half a cache at once
+        while (!pooled.empty() && local.size() < kCachedStacks / 2) {
+            local.push_back(pooled.back());
+            pooled.pop_back();
+        }
+    }
+    if (local.empty()) return map_stack();
+    void* stack = local.back();
+    local.pop_back();
+    return stack;
+}
+
+void release_stack(void* stack) {
+    auto& local = stack_cache.stacks_;
+    if (local.size() < kCachedStacks) {
+        local.push_back(stack);
+        return;
+    }
+    {
+        std::scoped_lock lock(pool_sync);
+        if (pooled.size() < kPooledStacks) {
+            pooled.push_back(stack);
+            return;
+        }
+    }
+    munmap(stack, kMappingSize);
+}
+
+thread_local Fiber* current_fiber = nullptr;
+
+}
+
+// ================ FIBER =================================
+
+Fiber::Fiber(ThreadPool* pool, void* stack, Closure body): pool_(pool), stack_(stack), body_(std::move(body)) {
+    // below the Fiber object at the top of the mapping, 16 byte aligned
+    auto base = reinterpret_cast<uintptr_t>(this) & ~uintptr_t(15);
+    rsp_ = nasm_init(reinterpret_cast<void*>(base), trampoline);
+}
+
+void Fiber::spawn(ThreadPool* pool, Closure body) {
+    void* stack = acquire_stack();
+    void* top = static_cast<char*>(stack) + kMappingSize - sizeof(Fiber);
+    top = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(top) & ~uintptr_t(alignof(Fiber) - 1));
+    auto* fiber = new (top) Fiber(pool, stack, std::move(body));
+    fiber->schedule();
+}
+
+Fiber* Fiber::current() {
+    return current_fiber;
+}
+
+void Fiber::schedule() {
+    func_ = [this]{ enter(this); };
+    pool_->run(this);
+}
+
+void Fiber::wake() {
+    schedule();
+}
+
+// worker side: run the fiber until it switches back, then act on why it did
+void Fiber::enter(Fiber* fiber) {
+    current_fiber = fiber;
+    fiber->state_ = State::Running;
+    nasm_switch(&fiber->worker_rsp_, fiber->rsp_, fiber, nullptr);
+    current_fiber = nullptr;
+    switch (fiber->state_) {
+        case State::Yielded:
+            fiber->func_ = [fiber]{ enter(fiber); };
+            fiber->pool_->yield(fiber);
+            break;
+        case State::Parked:
+            fiber->after_(fiber, fiber->after_arg_);
+            break;
+        case State::Finished: {
+            void* stack = fiber->stack_;
+            fiber->~Fiber();
+            release_stack(stack);
+            break;
+        }
+        case State::Running:
+            break;
+    }
+}
+
+// fiber side. Nothing thread local may be touched after the switch, the fiber can come
+// back on another worker
+void Fiber::switch_out(State state) {
+    state_ = state;
+    nasm_switch(&rsp_, worker_rsp_, nullptr, nullptr);
+}
+
+void Fiber::yield() {
+    Fiber* fiber = current_fiber;
+    if (fiber == nullptr) return;
+    fiber->switch_out(State::Yielded);
+}
+
+void Fiber::park(void (*after)(Fiber*, void*), void* arg) {
+    Fiber* fiber = current_fiber;
+    fiber->after_ = after;
+    fiber->after_arg_ = arg;
+    fiber->switch_out(State::Parked);
+}
+
+void Fiber::trampoline(void* arg, void*) {
+    auto* fiber = static_cast<Fiber*>(arg);
+    try {
+        fiber->body_();
+    } catch (...) {
+        std::cerr << "exception escaped a fiber" << std::endl;
+        std::terminate();
+    }
+    fiber->body_.reset();
+    fiber->switch_out(State::Finished);
+    __builtin_unreachable(); // nasm_init left no return address
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+#include "threadpool.hpp"
+
+// context switch from 03-fibers/nasm
+extern "C" {
+    // saves callee saved registers on the current stack, stores rsp in *old_rsp and
+    // continues on new_rsp, arg1/arg2 land in rdi/rsi (seen by a fresh stack's entry function)
+    void nasm_switch(void** old_rsp, void* new_rsp, void* arg1, void* arg2);
+    // prepares a stack at `base` to enter func(arg1, arg2) on the first switch, returns its rsp
+    void* nasm_init(void* base, void (*func)(void*, void*));
+}
+
+// Stackful fibers multiplexed over ThreadPool workers (M:N).
+// A runnable fiber is a pool task: the worker that picks it up switches onto the fiber's stack
+// and back when the fiber yields, parks or finishes, so fibers move between workers freely.
+// Stacks are mmap'd with a guard page below them and recycled through a pool, the Fiber
+// object itself lives at the top of its stack.
+class Fiber : ThreadPool::Task {
+public:
+    using Closure = ThreadPool::Closure;
+    constexpr static size_t kStackSize = 64 * 1024;
+
+    static void spawn(ThreadPool* pool, Closure body);
+
+    // from inside a fiber
+    static Fiber* current();
+    // back to the end of the pool's queue
+    static void yield();
+    // suspends the current fiber, `after` runs on the worker once the fiber is off its stack,
+    // so it may hand the fiber to whoever wakes it up later
+    static void park(void (*after)(Fiber* fiber, void* arg), void* arg);
+
+    // makes a parked fiber runnable again, any thread
+    void wake();
+
+private:
+    enum class State { Running, Yielded, Parked, Finished };
+
+    Fiber(ThreadPool* pool, void* stack, Closure body);
+    void schedule();
+    void switch_out(State state);
+    static void enter(Fiber* fiber);
+    static void trampoline(void* fiber, void*);
+
+    ThreadPool* pool_;
+    void* stack_;         // mapping, guard page included
+    void* rsp_ = nullptr; // saved fiber context
+    void* worker_rsp_ = nullptr; // context of the worker running it
+    State state_ = State::Parked;
+    Closure body_;
+    void (*after_)(Fiber*, void*) = nullptr;
+    void* after_arg_ = nullptr;
+};
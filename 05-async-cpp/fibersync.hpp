@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+#include "parkinglot.hpp"
+
+// Mutex and condition variable for fibers on top of the ParkingLot. Waiting suspends the
+// fiber, not the worker thread.
+
+// Drepper's three state futex mutex: 0 free, 1 locked, 2 locked and maybe contended.
+// Only an unlock of a contended lock goes to the parking lot
+class FiberMutex {
+public:
+    void lock() {
+        int expected = 0;
+        if (state_.compare_exchange_strong(expected, 1, std::memory_order_acquire)) return;
+        while (state_.exchange(2, std::memory_order_acquire) != 0) {
+            ParkingLot::park(&state_, 2);
+        }
+    }
+
+    bool try_lock() {
+        int expected = 0;
+        return state_.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        if (state_.exchange(0, std::memory_order_release) == 2) ParkingLot::unpark(&state_);
+    }
+
+private:
+    std::atomic<int> state_ = 0;
+};
+
+// Sequence number condition variable: a notify between unlocking the mutex and parking
+// changes the number, so park() returns right away instead of missing it
+class FiberCondVar {
+public:
+    void wait(FiberMutex& mutex) {
+        int seq = seq_.load(std::memory_order_relaxed);
+        mutex.unlock();
+        ParkingLot::park(&seq_, seq);
+        mutex.lock();
+    }
+
+    template<typename Pred>
+    void wait(FiberMutex& mutex, Pred pred) {
+        while (!pred()) wait(mutex);
+    }
+
+    void notify_one() {
+        seq_.fetch_add(1, std::memory_order_relaxed);
+        ParkingLot::unpark(&seq_);
+    }
+
+    void notify_all() {
+        seq_.fetch_add(1, std::memory_order_relaxed);
+        ParkingLot::unpark_all(&seq_);
+    }
+
+private:
+    std::atomic<int> seq_ = 0;
+};
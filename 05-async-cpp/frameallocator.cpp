@@ -0,0 +1,129 @@
+#include "frameallocator.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <cstdint>
+
+namespace {
+
+constexpr size_t kHeaderSize = 16; // keeps frames 16 byte aligned
+constexpr size_t kClasses = 7;     // 64 .. 4096 including the header
+constexpr size_t kSlabSize = 64 * 1024;
+
+struct Cache;
+
+struct Header {
+    Cache* owner_;   // nullptr - allocated with operator new
+    uint32_t class_;
+};
+
+struct FreeBlock {
+    FreeBlock* next_;
+};
+
+size_t class_of(size_t size) {
+    size_t total = size + kHeaderSize;
+    size_t cls = 0;
+    while ((size_t(64) << cls) < total) cls++;
+    return cls;
+}
+
+struct Cache {
+    FreeBlock* local_[kClasses] = {};
+    std::atomic<FreeBlock*> remote_[kClasses] = {};
+
+    void* allocate(size_t cls) {
+        FreeBlock* block = local_[cls];
+        if (block == nullptr) {
+            // take everything other threads gave back
+            block = remote_[cls].exchange(nullptr, std::memory_order_acquire);
+            if (block == nullptr) block = carve(cls);
+        }
+        local_[cls] = block->next_;
+        auto* header = reinterpret_cast<Header*>(block);
+        header->owner_ = this;
+        header->class_ = cls;
+        return reinterpret_cast<char*>(block) + kHeaderSize;
+    }
+
+    void free_local(void* block, size_t cls) {
+        auto* b = static_cast<FreeBlock*>(block);
+        b->next_ = local_[cls];
+        local_[cls] = b;
+    }
+
+    void free_remote(void* block, size_t cls) {
+        auto* b = static_cast<FreeBlock*>(block);
+        b->next_ = remote_[cls].load(std::memory_order_relaxed);
+        while (!remote_[cls].compare_exchange_weak(b->next_, b,
+                    std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // a new slab split into blocks, returned as a list
+    FreeBlock* carve(size_t cls) {
+        size_t block_size = size_t(64) << cls;
+        char* slab = static_cast<char*>(::operator new(kSlabSize));
+        FreeBlock* head = nullptr;
+        for (size_t off = kSlabSize; off >= block_size; off -= block_size) {
+            auto* b = reinterpret_cast<FreeBlock*>(slab + off - block_size);
+            b->next_ = head;
+            head = b;
+        }
+        return head;
+    }
+};
+
+// caches outlive their threads: blocks may still be in flight to them.
+// Never destroyed, pool threads of static pools exit after static destructors ran
+std::mutex orphans_sync;
+std::vector<Cache*>& orphans = *new std::vector<Cache*>();
+
+struct CacheHolder {
+    Cache* cache_;
+    CacheHolder() {
+        std::scoped_lock lock(orphans_sync);
+        if (orphans.empty()) {
+            cache_ = new Cache;
+        } else {
+            cache_ = orphans.back();
+            orphans.pop_back();
+        }
+    }
+    ~CacheHolder() {
+        std::scoped_lock lock(orphans_sync);
+        orphans.push_back(cache_);
+        cache_ = nullptr; // frames freed later during thread exit take the remote path
+    }
+};
+
+thread_local CacheHolder holder;
+
+}
+
+void* FrameAllocator::allocate(size_t size) {
+    Cache* cache = holder.cache_;
+    if (size + kHeaderSize > kMaxSize || cache == nullptr) {
+        char* raw = static_cast<char*>(::operator new(size + kHeaderSize));
+        reinterpret_cast<Header*>(raw)->owner_ = nullptr;
+        return raw + kHeaderSize;
+    }
+    return cache->allocate(class_of(size));
+}
+
+void FrameAllocator::deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+    char* raw = static_cast<char*>(ptr) - kHeaderSize;
+    auto* header = reinterpret_cast<Header*>(raw);
+    Cache* owner = header->owner_;
+    if (owner == nullptr) {
+        ::operator delete(raw);
+        return;
+    }
+    if (owner == holder.cache_) {
+        owner->free_local(raw, header->class_);
+    } else {
+        owner->free_remote(raw, header->class_);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Coroutine frame allocator with per-thread size class free lists.
+// Blocks are carved from slabs and remember their owning thread cache. A frame freed on
+// another thread (a coroutine that hopped through the pool) goes back to its owner through
+// a lock free remote list, which the owner drains when its local list runs dry.
+// Caches of exited threads are kept and adopted by new threads, slabs are never unmapped.
+class FrameAllocator {
+public:
+    constexpr static size_t kMaxSize = 4096; // bigger frames go to operator new
+
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr);
+};
+
+// Base for promise types, routes frame allocation through FrameAllocator
+struct PooledFrame {
+    static void* operator new(size_t size) { return FrameAllocator::allocate(size); }
+    static void operator delete(void* ptr) { FrameAllocator::deallocate(ptr); }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move only void() callable with inline storage.
+// Closures up to kInlineSize bytes (a coroutine handle, a few pointers) are stored in place,
+// bigger ones fall back to the heap.
+class InplaceTask {
+public:
+    constexpr static size_t kInlineSize = 48;
+
+    InplaceTask() = default;
+
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceTask>>>
+    InplaceTask(F&& func) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>()) {
+            new (storage_) Fn(std::forward<F>(func));
+            vtable_ = &kInlineVTable<Fn>;
+        } else {
+            new (storage_) Fn*(new Fn(std::forward<F>(func)));
+            vtable_ = &kHeapVTable<Fn>;
+        }
+    }
+
+    InplaceTask(InplaceTask&& o) noexcept {
+        if (o.vtable_ != nullptr) {
+            o.vtable_->move_(storage_, o.storage_);
+            vtable_ = std::exchange(o.vtable_, nullptr);
+        }
+    }
+
+    InplaceTask& operator=(InplaceTask&& o) noexcept {
+        if (this != &o) {
+            reset();
+            if (o.vtable_ != nullptr) {
+                o.vtable_->move_(storage_, o.storage_);
+                vtable_ = std::exchange(o.vtable_, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    InplaceTask(const InplaceTask&) = delete;
+    InplaceTask& operator=(const InplaceTask&) = delete;
+
+    ~InplaceTask() { reset(); }
+
+    void operator()() { vtable_->invoke_(storage_); }
+
+    explicit operator bool() const { return vtable_ != nullptr; }
+
+    void reset() {
+        if (vtable_ != nullptr) {
+            vtable_->destroy_(storage_);
+            vtable_ = nullptr;
+        }
+    }
+
+    template<typename F>
+    constexpr static bool fits_inline() {
+        return sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<F>;
+    }
+
+private:
+    struct VTable {
+        void (*invoke_)(void*);
+        void (*move_)(void* dst, void* src); // move constructs dst and destroys src
+        void (*destroy_)(void*);
+    };
+
+    template<typename Fn>
+    constexpr static VTable kInlineVTable = {
+        [](void* s) { (*static_cast<Fn*>(s))(); },
+        [](void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* s) { static_cast<Fn*>(s)->~Fn(); }
+    };
+
+    template<typename Fn>
+    constexpr static VTable kHeapVTable = {
+        [](void* s) { (**static_cast<Fn**>(s))(); },
+        [](void* dst, void* src) { new (dst) Fn*(*static_cast<Fn**>(src)); },
+        [](void* s) { delete *static_cast<Fn**>(s); }
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const VTable* vtable_ = nullptr;
+};
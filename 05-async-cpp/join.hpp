@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "task.hpp"
+#include "cancel.hpp"
+
+// Structured concurrency on top of Task<T>.
+//   co_await when_all(a, b, c)   -> tuple of results (std::monostate for void)
+//   co_await when_all(vector)    -> vector of results, or void
+//   co_await when_any(a, b, c)   -> WhenAny<T>{index_, value_} of the first task to finish
+//   Nursery n; n.spawn(task); co_await n.join();
+// All children start right away on the awaiting thread. Completion is one atomic counter per
+// group, the last child to finish resumes the awaiting coroutine by symmetric transfer.
+// Children get the group's stop token: when_any stops the losers once there is a winner,
+// when_all and Nursery stop the rest after the first exception, which is rethrown on join.
+// Cancellation of the awaiting task reaches the children too.
+
+template<typename T>
+struct WhenAny {
+    size_t index_;
+    T value_;
+};
+
+namespace detail {
+
+template<typename T>
+using Result = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+// counts unfinished children plus one for the joining coroutine, rearmed once the wait is
+// over so the group can take new children
+struct Join {
+    std::atomic<size_t> count_ = 1;
+    std::coroutine_handle<> waiter_;
+
+    void add() { count_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::coroutine_handle<> arrive() {
+        if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) return waiter_;
+        return std::noop_coroutine();
+    }
+
+    struct Awaiter {
+        Join* join_;
+        bool await_ready() const noexcept {
+            return join_->count_.load(std::memory_order_acquire) == 1;
+        }
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            join_->waiter_ = h;
+            return join_->count_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+        void await_resume() const noexcept {
+            join_->count_.store(1, std::memory_order_relaxed);
+            join_->waiter_ = nullptr;
+        }
+    };
+    Awaiter wait() { return Awaiter{this}; }
+};
+
+// group cancellation linked to the parent's token, keeps the first failure
+struct Scope : Join {
+    std::stop_source source_;
+    std::atomic_bool failed_ = false;
+    std::exception_ptr exception_;
+
+    struct Link {
+        std::stop_source* source_;
+        void operator()() const { source_->request_stop(); }
+    };
+    std::optional<std::stop_callback<Link>> link_;
+
+    explicit Scope(std::stop_token parent) {
+        link_.emplace(std::move(parent), Link{&source_});
+    }
+
+    void fail(std::exception_ptr e) {
+        if (!failed_.exchange(true, std::memory_order_relaxed)) exception_ = std::move(e);
+        source_.request_stop();
+    }
+
+    void rethrow() {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+};
+
+// wraps one child, frees itself and reports to the join when done
+struct JoinChild {
+    struct promise_type : PooledFrame, Cancellable {
+        Join* join_ = nullptr;
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                Join* join = h.promise().join_;
+                h.destroy();
+                return join->arrive();
+            }
+            void await_resume() const noexcept {}
+        };
+
+        JoinChild get_return_object() {
+            return JoinChild{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> h_;
+
+    void start(Scope& scope) {
+        scope.add();
+        h_.promise().join_ = &scope;
+        h_.promise().stop_ = scope.source_.get_token();
+        h_.resume();
+    }
+};
+
+template<typename T>
+JoinChild all_child(Task<T> task, std::optional<Result<T>>& slot, Scope& scope) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+            slot.emplace();
+        } else {
+            slot.emplace(co_await task);
+        }
+    } catch (...) {
+        scope.fail(std::current_exception());
+    }
+}
+
+struct AnyScope : Scope {
+    constexpr static size_t kNone = size_t(-1);
+    std::atomic<size_t> winner_ = kNone;
+
+    using Scope::Scope;
+
+    // first one to finish wins, with a value or an exception
+    bool win(size_t index) {
+        size_t none = kNone;
+        if (!winner_.compare_exchange_strong(none, index, std::memory_order_relaxed)) return false;
+        source_.request_stop();
+        return true;
+    }
+};
+
+template<typename T>
+JoinChild any_child(Task<T> task, std::optional<Result<T>>& slot, AnyScope& scope, size_t index) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+            if (scope.win(index)) slot.emplace();
+        } else {
+            auto value = co_await task;
+            if (scope.win(index)) slot.emplace(std::move(value));
+        }
+    } catch (...) {
+        if (scope.win(index)) scope.exception_ = std::current_exception();
+    }
+}
+
+template<typename... Ts, size_t... Is>
+Task<std::tuple<Result<Ts>...>> when_all(std::index_sequence<Is...>, Task<Ts>... tasks) {
+    Scope scope(co_await current_stop_token());
+    std::tuple<std::optional<Result<Ts>>...> slots;
+    (all_child(std::move(tasks), std::get<Is>(slots), scope).start(scope), ...);
+    co_await scope.wait();
+    scope.rethrow();
+    co_return std::tuple<Result<Ts>...>(std::move(*std::get<Is>(slots))...);
+}
+
+}
+
+template<typename... Ts>
+Task<std::tuple<detail::Result<Ts>...>> when_all(Task<Ts>... tasks) {
+    return detail::when_all(std::index_sequence_for<Ts...>(), std::move(tasks)...);
+}
+
+template<typename T>
+Task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> when_all(std::vector<Task<T>> tasks) {
+    detail::Scope scope(co_await current_stop_token());
+    std::vector<std::optional<detail::Result<T>>> slots(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        detail::all_child(std::move(tasks[i]), slots[i], scope).start(scope);
+    }
+    co_await scope.wait();
+    scope.rethrow();
+    if constexpr (!std::is_void_v<T>) {
+        std::vector<T> results;
+        results.reserve(slots.size());
+        for (auto& slot: slots) results.push_back(std::move(*slot));
+        co_return results;
+    }
+}
+
+// the losers are cancelled and joined before this returns, an empty vector is an error
+template<typename T>
+Task<WhenAny<detail::Result<T>>> when_any(std::vector<Task<T>> tasks) {
+    if (tasks.empty()) throw std::invalid_argument("when_any of nothing");
+    detail::AnyScope scope(co_await current_stop_token());
+    std::vector<std::optional<detail::Result<T>>> slots(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        detail::any_child(std::move(tasks[i]), slots[i], scope, i).start(scope);
+    }
+    co_await scope.wait();
+    scope.rethrow();
+    size_t winner = scope.winner_.load(std::memory_order_relaxed);
+    co_return WhenAny<detail::Result<T>>{winner, std::move(*slots[winner])};
+}
+
+template<typename T, typename... Ts>
+Task<WhenAny<detail::Result<T>>> when_any(Task<T> first, Task<Ts>... rest) {
+    static_assert((std::is_same_v<T, Ts> && ...), "when_any needs tasks of one type");
+    std::vector<Task<T>> tasks;
+    tasks.reserve(1 + sizeof...(Ts));
+    tasks.push_back(std::move(first));
+    (tasks.push_back(std::move(rest)), ...);
+    return when_any(std::move(tasks));
+}
+
+// Async scope: children run until join() completes, which every nursery needs before it dies.
+// Children spawned after a join need another one, a failure or cancellation stays
+class Nursery {
+public:
+    explicit Nursery(std::stop_token parent = {}): scope_(std::move(parent)) {}
+    Nursery(const Nursery&) = delete;
+    Nursery& operator=(const Nursery&) = delete;
+
+    void spawn(Task<void> task) {
+        child(std::move(task), scope_).start(scope_);
+    }
+
+    void cancel() { scope_.source_.request_stop(); }
+
+    // waits for every child, rethrows the first failure
+    Task<void> join() {
+        co_await scope_.wait();
+        scope_.rethrow();
+    }
+
+private:
+    static detail::JoinChild child(Task<void> task, detail::Scope& scope) {
+        try {
+            co_await task;
+        } catch (...) {
+            scope.fail(std::current_exception());
+        }
+    }
+
+    detail::Scope scope_;
+};
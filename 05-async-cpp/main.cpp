@@ -1,83 +1,55 @@
 #include <iostream>
 #include <chrono>
-#include <memory>
-#include <coroutine>
 
 #include "threadpool.hpp"
 #include "sleeper.hpp"
+#include "task.hpp"
+#include "join.hpp"
 
 using namespace std::chrono_literals;
 ThreadPool pool;
 Sleeper sleeper(&pool);
 
-// Timer futures 
-
-struct Promise {
-    struct promise_type {
-        Promise get_return_object() {
-          return Promise {
-            std::coroutine_handle<promise_type>::from_promise(*this)
-          };
-        }
-        std::suspend_never initial_suspend() { return {}; }
-        std::suspend_never final_suspend() noexcept { return {}; }
-        void return_void() {}   
-        void unhandled_exception() {}
-    };
-    std::coroutine_handle<promise_type> h_;
-    operator std::coroutine_handle<promise_type>() const { return h_; }
-};
-
-struct Timer {
-    Timer(int ms): ms(ms) {}
-    int ms;    
-};
-
-struct TimerAwaiter {
-    TimerAwaiter(Timer&& t) : timer(t) {}
-    constexpr bool await_ready() const noexcept {
-        return timer.ms == 0;
-    }
-    void await_suspend(std::coroutine_handle<> h) {
-        sleeper.run(timer.ms, [h]{
-            h.resume();
-        });
-    }
-    constexpr int await_resume() const noexcept {
-        return timer.ms;
-    }
-    Timer timer;
-};
-
-auto operator co_await(Timer&& t) {
-    return TimerAwaiter(std::move(t));
-}
-
 // Test
 
 std::atomic<int> counter;
 
-Promise testSleep(int id) {
+Task<void> testSleep(int id) {
     std::cout << "  sleep " << id << std::endl;
-    co_await Timer(500);
+    co_await sleeper.sleep(500);
     std::cout << "      step " << id << std::endl;
-    co_await Timer(500);
+    co_await sleeper.sleep(500);
     std::cout << "  wakeup " << id << std::endl;
 
     counter.fetch_add(1);
 }
 
-void testManySleep() {
+Task<void> testManySleep() {
     std::cout << "== start " << std::endl;
-    for (int i = 0; i < 10; i++) testSleep(i);
+    Nursery nursery;
+    for (int i = 0; i < 10; i++) nursery.spawn(testSleep(i));
+    co_await nursery.join();
+    // joined nurseries take new children
+    nursery.spawn(testSleep(10));
+    co_await nursery.join();
     std::cout << "== end" << std::endl;
 }
 
-int main() {
-    testManySleep();
+Task<int> delayed(int ms) {
+    bool fired = co_await sleeper.sleep(ms);
+    if (!fired) std::cout << "  cancelled " << ms << std::endl;
+    co_return ms;
+}
 
+Task<void> testRace() {
+    std::cout << "== race" << std::endl;
+    auto [fast, slow] = co_await when_all(delayed(100), delayed(200));
+    auto first = co_await when_any(delayed(1000), delayed(100), delayed(60'000));
+    std::cout << "  all " << fast << " " << slow << ", any " << first.value_ << std::endl;
+}
 
-    while (counter.load() != 10) {
-        std::this_thread::sleep_for(1s);
-    }
-}
\ No newline at end of file
+int main() {
+    sync_wait(testManySleep());
+    sync_wait(testRace());
+    return counter.load() == 11 ? 0 : 1;
+}
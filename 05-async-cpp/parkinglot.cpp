@@ -0,0 +1,88 @@
+#include "parkinglot.hpp"
+
+#include <mutex>
+
+namespace {
+
+// lives on the parked fiber's stack
+struct Waiter {
+    const void* addr_;
+    Fiber* fiber_;
+    Waiter* next_ = nullptr;
+};
+
+struct alignas(64) Bucket {
+    std::mutex sync_;
+    Waiter* head_ = nullptr;
+    Waiter* tail_ = nullptr;
+};
+
+constexpr size_t kBucketBits = 9;
+Bucket buckets[1 << kBucketBits];
+
+// fibonacci hashing, the top bits are the well mixed ones
+Bucket& bucket_of(const void* addr) {
+    auto key = reinterpret_cast<uintptr_t>(addr) * 0x9E3779B97F4A7C15ull;
+    return buckets[key >> (64 - kBucketBits)];
+}
+
+}
+
+bool ParkingLot::park(const std::atomic<int>* addr, int expected) {
+    Fiber* fiber = Fiber::current();
+    Bucket& bucket = bucket_of(addr);
+    bucket.sync_.lock();
+    if (addr->load(std::memory_order_relaxed) != expected) {
+        bucket.sync_.unlock();
+        return false;
+    }
+    Waiter waiter{addr, fiber};
+    if (bucket.tail_ != nullptr) bucket.tail_->next_ = &waiter;
+    else bucket.head_ = &waiter;
+    bucket.tail_ = &waiter;
+    // the bucket stays locked until the fiber is off its stack, so nobody wakes it too early.
+    // The worker that unlocks is the one that locked
+    Fiber::park([](Fiber*, void* arg) {
+        static_cast<Bucket*>(arg)->sync_.unlock();
+    }, &bucket);
+    return true;
+}
+
+size_t ParkingLot::unpark(const void* addr, size_t count) {
+    Bucket& bucket = bucket_of(addr);
+    Waiter* woken = nullptr;
+    size_t n = 0;
+    {
+        std::scoped_lock lock(bucket.sync_);
+        Waiter* prev = nullptr;
+        Waiter* w = bucket.head_;
+        while (w != nullptr && n < count) {
+            Waiter* next = w->next_;
+            if (w->addr_ == addr) {
+                if (prev != nullptr) prev->next_ = next;
+                else bucket.head_ = next;
+                if (bucket.tail_ == w) bucket.tail_ = prev;
+                w->next_ = woken;
+                woken = w;
+                n++;
+            } else {
+                prev = w;
+            }
+            w = next;
+        }
+    }
+    // reversed, so wake the oldest first. The waiter dies with the fiber's next slice
+    Waiter* order = nullptr;
+    while (woken != nullptr) {
+        Waiter* next = woken->next_;
+        woken->next_ = order;
+        order = woken;
+        woken = next;
+    }
+    while (order != nullptr) {
+        Waiter* next = order->next_;
+        order->fiber_->wake();
+        order = next;
+    }
+    return n;
+}
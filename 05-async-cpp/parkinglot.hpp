@@ -0,0 +1,20 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "fiber.hpp"
+
+// Futex for fibers: a user space hash table of waiting fibers keyed by address.
+// park() suspends only the calling fiber, its worker moves on to the next runnable one.
+// Fiber only, a plain thread has nothing to switch to.
+class ParkingLot {
+public:
+    // parks the current fiber if *addr still holds `expected`, checked under the bucket lock
+    // so a wake between the caller's check and the park can't get lost.
+    // false if the value had changed
+    static bool park(const std::atomic<int>* addr, int expected);
+    // wakes up to `count` fibers parked on addr, oldest first, returns how many
+    static size_t unpark(const void* addr, size_t count = 1);
+    static size_t unpark_all(const void* addr) { return unpark(addr, size_t(-1)); }
+};
@@ -0,0 +1,578 @@
+#include "reactor.hpp"
+
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+using Operation = Reactor::Operation;
+using Task = ThreadPool::Task;
+
+namespace {
+
+void push(Task*& list, Task* task) {
+    task->next_ = list;
+    list = task;
+}
+
+// ================ EPOLL =================================
+// Every descriptor is registered once, edge triggered for both directions.
+// Operations that would block wait in per descriptor FIFOs until the next edge.
+
+class EpollBackend : public Reactor::Impl {
+public:
+    EpollBackend() {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = evfd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, evfd_, &ev);
+    }
+
+    ~EpollBackend() override {
+        close(evfd_);
+        close(epfd_);
+    }
+
+    void submit(Operation* ops, Task*& done) override {
+        while (ops != nullptr) {
+            auto* op = ops;
+            ops = static_cast<Operation*>(ops->next_);
+            if (op->kind_ == Operation::Kind::Close) {
+                auto it = fds_.find(op->fd_);
+                if (it != fds_.end()) {
+                    it->second.readers_.cancel(done);
+                    it->second.writers_.cancel(done);
+                    fds_.erase(it);
+                }
+                op->result_ = op->perform();
+                push(done, op);
+                continue;
+            }
+            if (op->expired_) {
+                op->result_ = -ETIMEDOUT;
+                push(done, op);
+                continue;
+            }
+            Fd& fd = fds_[op->fd_];
+            if (!fd.registered_) {
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.fd = op->fd_;
+                if (epoll_ctl(epfd_, EPOLL_CTL_ADD, op->fd_, &ev) != 0 && errno == EPERM) {
+                    fd.pollable_ = false; // regular file, always ready
+                }
+                fd.registered_ = true;
+            }
+            Waiters& waiters = op->kind_ == Operation::Kind::Write ? fd.writers_ : fd.readers_;
+            // registered now, so readiness that came after the inline attempt shows up here
+            // or as an edge later
+            if (waiters.empty()) {
+                int64_t result = op->perform();
+                if (result != -EAGAIN || !fd.pollable_) {
+                    op->result_ = result;
+                    push(done, op);
+                    continue;
+                }
+            }
+            waiters.push_back(op);
+        }
+    }
+
+    void cancel(Operation* op, Task*& done) override {
+        op->expired_ = true;
+        auto it = fds_.find(op->fd_);
+        if (it == fds_.end()) return;
+        Waiters& waiters = op->kind_ == Operation::Kind::Write ? it->second.writers_ : it->second.readers_;
+        if (waiters.remove(op)) {
+            op->result_ = -ETIMEDOUT;
+            push(done, op);
+        }
+    }
+
+    void wait(Task*& done, bool block) override {
+        epoll_event events[128];
+        int n = epoll_wait(epfd_, events, 128, block ? -1 : 0);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == evfd_) {
+                uint64_t value;
+                while (read(evfd_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            auto it = fds_.find(fd);
+            if (it == fds_.end()) continue;
+            uint32_t e = events[i].events;
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) it->second.readers_.drain(done);
+            if (e & (EPOLLOUT | EPOLLERR | EPOLLHUP)) it->second.writers_.drain(done);
+        }
+    }
+
+    void wake() override {
+        uint64_t one = 1;
+        write(evfd_, &one, sizeof(one));
+    }
+
+private:
+    struct Waiters {
+        Operation* head_ = nullptr;
+        Operation* tail_ = nullptr;
+        bool empty() const { return head_ == nullptr; }
+        void push_back(Operation* op) {
+            op->next_ = nullptr;
+            if (tail_ != nullptr) tail_->next_ = op;
+            else head_ = op;
+            tail_ = op;
+        }
+        bool remove(Operation* op) {
+            Operation* prev = nullptr;
+            for (Operation* cur = head_; cur != nullptr; prev = cur, cur = static_cast<Operation*>(cur->next_)) {
+                if (cur != op) continue;
+                if (prev != nullptr) prev->next_ = cur->next_;
+                else head_ = static_cast<Operation*>(cur->next_);
+                if (tail_ == cur) tail_ = prev;
+                return true;
+            }
+            return false;
+        }
+        // the descriptor is being closed
+        void cancel(Task*& done) {
+            while (head_ != nullptr) {
+                Operation* op = head_;
+                head_ = static_cast<Operation*>(op->next_);
+                op->result_ = -ECANCELED;
+                push(done, op);
+            }
+            tail_ = nullptr;
+        }
+        // retry in order until one would block again
+        void drain(Task*& done) {
+            while (head_ != nullptr) {
+                int64_t result = head_->perform();
+                if (result == -EAGAIN) return;
+                Operation* op = head_;
+                head_ = static_cast<Operation*>(op->next_);
+                if (head_ == nullptr) tail_ = nullptr;
+                op->result_ = result;
+                push(done, op);
+            }
+        }
+    };
+
+    struct Fd {
+        Waiters readers_;
+        Waiters writers_;
+        bool registered_ = false;
+        bool pollable_ = true;
+    };
+
+    int epfd_;
+    int evfd_;
+    std::unordered_map<int, Fd> fds_;
+};
+
+// ================ IO_URING ==============================
+// Raw syscalls, no liburing. user_data is the Operation, 0 is the wakeup eventfd read,
+// a set low bit marks a poll armed for an operation that got -EAGAIN from a non blocking fd
+// and bit 1 the cancellations of an expired operation. Both bits are the cancellation of
+// everything in flight on a descriptor being closed, the close itself runs once it is back.
+
+class UringBackend : public Reactor::Impl {
+public:
+    constexpr static unsigned kEntries = 256;
+
+    static std::unique_ptr<UringBackend> create() {
+        auto backend = std::unique_ptr<UringBackend>(new UringBackend());
+        if (!backend->setup()) return nullptr;
+        return backend;
+    }
+
+    ~UringBackend() override {
+        if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+        if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_ != nullptr) munmap(sq_ptr_, sq_size_);
+        if (ring_fd_ >= 0) close(ring_fd_);
+        if (evfd_ >= 0) close(evfd_);
+    }
+
+    void submit(Operation* ops, Task*& done) override {
+        while (ops != nullptr) {
+            auto* op = ops;
+            ops = static_cast<Operation*>(ops->next_);
+            if (op->kind_ == Operation::Kind::Close) {
+                // cancel what is in flight on it first: the ring holds its own reference
+                // to the file, a plain close would leave those waiting
+                closing_.insert(op->fd_);
+                io_uring_sqe* sqe = next_sqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = op->fd_;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+                sqe->user_data = reinterpret_cast<uint64_t>(op) | 3;
+                commit();
+                continue;
+            }
+            if (op->expired_) {
+                op->result_ = -ETIMEDOUT;
+                push(done, op);
+                continue;
+            }
+            prepare(op, done);
+        }
+    }
+
+    // the operation or the poll armed for it, whichever is in flight, comes back -ECANCELED
+    void cancel(Operation* op, Task*&) override {
+        op->expired_ = true;
+        uint64_t data = reinterpret_cast<uint64_t>(op);
+        for (uint64_t target: {data, data | 1}) {
+            io_uring_sqe* sqe = next_sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = target;
+            sqe->user_data = data | 2;
+            commit();
+        }
+    }
+
+    void wait(Task*& done, bool block) override {
+        if (to_submit_ > 0 || block) {
+            unsigned flags = block ? IORING_ENTER_GETEVENTS : 0;
+            int r = syscall(__NR_io_uring_enter, ring_fd_, to_submit_, block ? 1 : 0, flags, nullptr, 0);
+            if (r >= 0) to_submit_ -= r;
+        }
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+            uint64_t data = cqe.user_data;
+            int res = cqe.res;
+            if (data == 0) {
+                arm_wakeup();
+            } else if ((data & 3) == 3) {
+                // -EINVAL before 5.19, which cannot cancel by descriptor; closed regardless
+                auto* op = reinterpret_cast<Operation*>(data & ~uint64_t(3));
+                closing_.erase(op->fd_);
+                op->result_ = op->perform();
+                push(done, op);
+            } else if (data & 2) {
+                // a cancellation, the operation reports on its own
+            } else if (data & 1) {
+                auto* op = reinterpret_cast<Operation*>(data & ~uint64_t(1));
+                if (op->expired_) {
+                    op->result_ = -ETIMEDOUT;
+                    push(done, op);
+                } else if (res < 0) {
+                    op->result_ = res;
+                    push(done, op);
+                } else {
+                    prepare(op, done); // became ready
+                }
+            } else {
+                auto* op = reinterpret_cast<Operation*>(data);
+                if (op->expired_ && (res == -ECANCELED || res == -EINTR || res == -EAGAIN)) {
+                    op->result_ = -ETIMEDOUT;
+                    push(done, op);
+                } else if (res == -EAGAIN && !closing_.empty() && closing_.count(op->fd_)) {
+                    op->result_ = -ECANCELED; // missed the cancellation, don't wait again
+                    push(done, op);
+                } else if (res == -EAGAIN) {
+                    poll(op);
+                } else {
+                    op->result_ = res;
+                    push(done, op);
+                }
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    void wake() override {
+        uint64_t one = 1;
+        write(evfd_, &one, sizeof(one));
+    }
+
+private:
+    UringBackend() = default;
+
+    bool setup() {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = syscall(__NR_io_uring_setup, kEntries, &p);
+        if (ring_fd_ < 0) return false;
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; return false; }
+        if (single) {
+            cq_ptr_ = sq_ptr_;
+        } else {
+            cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; return false; }
+        }
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+        auto* cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        evfd_ = eventfd(0, EFD_CLOEXEC);
+        if (evfd_ < 0) return false;
+        arm_wakeup();
+        return true;
+    }
+
+    // next free submission entry, flushes to the kernel when the ring is full
+    io_uring_sqe* next_sqe() {
+        unsigned tail = *sq_tail_;
+        while (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            int r = syscall(__NR_io_uring_enter, ring_fd_, to_submit_, 0, 0, nullptr, 0);
+            if (r > 0) to_submit_ -= r;
+        }
+        unsigned index = tail & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        return sqe;
+    }
+
+    void commit() {
+        __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+        to_submit_++;
+    }
+
+    void prepare(Operation* op, Task*& done) {
+        if (!closing_.empty() && closing_.count(op->fd_)) {
+            op->result_ = -ECANCELED;
+            push(done, op);
+            return;
+        }
+        io_uring_sqe* sqe = next_sqe();
+        sqe->fd = op->fd_;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+        switch (op->kind_) {
+            case Operation::Kind::Read:
+                sqe->opcode = IORING_OP_READ;
+                sqe->addr = reinterpret_cast<uint64_t>(op->buf_);
+                sqe->len = op->len_;
+                sqe->off = -1; // current position, like read(2)
+                break;
+            case Operation::Kind::Write:
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<uint64_t>(op->buf_);
+                sqe->len = op->len_;
+                sqe->off = -1;
+                break;
+            case Operation::Kind::Accept:
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+                break;
+            case Operation::Kind::Close:
+                break;
+        }
+        commit();
+    }
+
+    void poll(Operation* op) {
+        io_uring_sqe* sqe = next_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = op->fd_;
+        sqe->poll_events = op->kind_ == Operation::Kind::Write ? POLLOUT : POLLIN;
+        sqe->user_data = reinterpret_cast<uint64_t>(op) | 1;
+        commit();
+    }
+
+    void arm_wakeup() {
+        io_uring_sqe* sqe = next_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = evfd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&wakeup_value_);
+        sqe->len = sizeof(wakeup_value_);
+        sqe->user_data = 0;
+        commit();
+    }
+
+    int ring_fd_ = -1;
+    int evfd_ = -1;
+    uint64_t wakeup_value_ = 0;
+    unsigned to_submit_ = 0;
+    std::unordered_set<int> closing_; // descriptors with a close in flight
+
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned sq_entries_;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    io_uring_cqe* cqes_;
+};
+
+}
+
+// =======================================================
+
+int64_t Operation::perform() {
+    ssize_t r = 0;
+    switch (kind_) {
+        case Kind::Read:
+            r = ::read(fd_, buf_, len_);
+            break;
+        case Kind::Write:
+            r = ::send(fd_, buf_, len_, MSG_NOSIGNAL);
+            if (r < 0 && errno == ENOTSOCK) r = ::write(fd_, buf_, len_);
+            break;
+        case Kind::Accept:
+            r = ::accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            break;
+        case Kind::Close:
+            r = ::close(fd_);
+            break;
+    }
+    if (r < 0) return errno == EWOULDBLOCK ? -EAGAIN : -errno;
+    return r;
+}
+
+bool Operation::await_ready() {
+    if (kind_ == Kind::Close) return false;
+    result_ = perform();
+    return result_ != -EAGAIN;
+}
+
+void Operation::await_suspend(std::coroutine_handle<> h) {
+    h_ = h;
+    func_ = [this]{ complete(); };
+    if (timeout_ms_ >= 0) {
+        refs_.store(2, std::memory_order_relaxed);
+        timer_.func_ = [this]{ reactor_->expire(this); };
+        timer_handle_ = reactor_->sleeper_->run(timeout_ms_, &timer_);
+    }
+    reactor_->submit(this);
+}
+
+void Operation::complete() {
+    // a timer that fired first is still with the loop, whoever is done second resumes
+    if (timeout_ms_ >= 0 && !reactor_->sleeper_->cancel(timer_handle_) &&
+            refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    h_.resume();
+}
+
+Reactor::Reactor(ThreadPool* pool, Backend backend): Reactor(pool, nullptr, backend) {}
+
+Reactor::Reactor(ThreadPool* pool, Sleeper& sleeper, Backend backend): Reactor(pool, &sleeper, backend) {}
+
+Reactor::Reactor(ThreadPool* pool, Sleeper* sleeper, Backend backend): pool_(pool), sleeper_(sleeper) {
+    if (backend != Backend::Epoll) {
+        impl_ = UringBackend::create();
+        if (impl_ != nullptr) backend_ = Backend::IoUring;
+        else if (backend == Backend::IoUring) std::cerr << "io_uring unavailable, using epoll" << std::endl;
+    }
+    if (impl_ == nullptr) {
+        impl_ = std::make_unique<EpollBackend>();
+        backend_ = Backend::Epoll;
+    }
+    thread_ = std::thread(loop, this);
+}
+
+Reactor::~Reactor() {
+    shutdown_.store(true);
+    impl_->wake();
+    thread_.join();
+}
+
+void Reactor::submit(Operation* op) {
+    bool first;
+    {
+        std::scoped_lock lock(sync_);
+        first = pending_ == nullptr && expired_ == nullptr;
+        op->next_ = pending_;
+        pending_ = op;
+    }
+    // the loop takes the whole list at once, one wakeup per batch is enough
+    if (first) impl_->wake();
+}
+
+// on the pool, from the operation's timer
+void Reactor::expire(Operation* op) {
+    bool first;
+    {
+        std::scoped_lock lock(sync_);
+        first = pending_ == nullptr && expired_ == nullptr;
+        op->next_expired_ = expired_;
+        expired_ = op;
+    }
+    if (first) impl_->wake();
+}
+
+void Reactor::loop(Reactor* reactor) {
+    for(;;) {
+        Operation* pending;
+        Operation* expired;
+        {
+            std::scoped_lock lock(reactor->sync_);
+            pending = reactor->pending_;
+            reactor->pending_ = nullptr;
+            expired = reactor->expired_;
+            reactor->expired_ = nullptr;
+        }
+        // submit in arrival order
+        Operation* ordered = nullptr;
+        while (pending != nullptr) {
+            auto* next = static_cast<Operation*>(pending->next_);
+            pending->next_ = ordered;
+            ordered = pending;
+            pending = next;
+        }
+        Task* done = nullptr;
+        reactor->impl_->submit(ordered, done);
+        // one that expired before it got here is marked and completes once submitted
+        while (expired != nullptr) {
+            Operation* op = expired;
+            expired = op->next_expired_;
+            reactor->impl_->cancel(op, done);
+            // the completion ran already and left the resume to us
+            if (op->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                op->func_ = [op]{ op->h_.resume(); };
+                push(done, op);
+            }
+        }
+        reactor->impl_->wait(done, done == nullptr && !reactor->shutdown_.load());
+        if (done != nullptr) reactor->pool_->run_batch(done);
+        if (reactor->shutdown_.load()) return;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/types.h>
+
+#include "threadpool.hpp"
+#include "sleeper.hpp"
+
+// I/O event loop on its own thread, completions resume the awaiting coroutines on the pool.
+//   co_await reactor.async_read(fd, buf, len)  -> bytes read or -errno
+//   co_await reactor.async_write(fd, buf, len) -> bytes written or -errno
+//   co_await reactor.async_accept(fd)          -> new non blocking socket or -errno
+//   co_await reactor.async_close(fd)           -> 0 or -errno
+// Read, write and accept take an optional deadline in ms on a reactor built with a Sleeper:
+//   co_await reactor.async_read(fd, buf, len, ms) -> as above, -ETIMEDOUT if still pending
+// The expired timer asks the loop to take the operation back (unlink it from the epoll
+// waiters, or cancel it in the ring), and whichever of the completion and the timer comes
+// second resumes the coroutine.
+// Sockets must be non blocking: every operation is first tried inline and only goes to the
+// loop if it would block. Operations queued in between two loop iterations are submitted as
+// one batch (one io_uring_enter, or one round of epoll registrations), completions of one
+// iteration go to the pool with one run_batch.
+// Backed by io_uring when the kernel allows it, epoll otherwise.
+// Operations still pending when the reactor is destroyed are dropped, their deadlines
+// must not fire after that. A plain close() of a descriptor with operations pending leaves
+// them waiting, async_close completes them with -ECANCELED.
+class Reactor {
+public:
+    enum class Backend {
+        Auto,
+        IoUring,
+        Epoll
+    };
+
+    // awaiter state, lives in the coroutine frame
+    struct Operation : ThreadPool::Task {
+        enum class Kind { Read, Write, Accept, Close };
+        Kind kind_;
+        int fd_;
+        void* buf_ = nullptr;
+        size_t len_ = 0;
+        int64_t result_ = 0;
+        Reactor* reactor_;
+
+        // deadline, -1 for none
+        int timeout_ms_ = -1;
+        Sleeper::Timer timer_;
+        Sleeper::Handle timer_handle_;
+        // the completion and the loop's handling of an expired timer
+        std::atomic<int> refs_ = 1;
+        bool expired_ = false; // loop thread only
+        Operation* next_expired_ = nullptr;
+        std::coroutine_handle<> h_;
+
+        Operation(Kind kind, int fd, void* buf, size_t len, Reactor* reactor, int timeout_ms)
+            : kind_(kind), fd_(fd), buf_(buf), len_(len), reactor_(reactor), timeout_ms_(timeout_ms) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        int64_t await_resume() const { return result_; }
+
+        // runs the syscall right away, -EAGAIN if it would block
+        int64_t perform();
+        // on the pool, once the loop is done with the operation
+        void complete();
+    };
+
+    explicit Reactor(ThreadPool* pool, Backend backend = Backend::Auto);
+    // with deadlines
+    Reactor(ThreadPool* pool, Sleeper& sleeper, Backend backend = Backend::Auto);
+    ~Reactor();
+
+    Backend backend() const { return backend_; }
+
+    Operation async_read(int fd, void* buf, size_t len, int timeout_ms = -1) {
+        return make(Operation::Kind::Read, fd, buf, len, timeout_ms);
+    }
+    Operation async_write(int fd, const void* buf, size_t len, int timeout_ms = -1) {
+        return make(Operation::Kind::Write, fd, const_cast<void*>(buf), len, timeout_ms);
+    }
+    Operation async_accept(int fd, int timeout_ms = -1) {
+        return make(Operation::Kind::Accept, fd, nullptr, 0, timeout_ms);
+    }
+    // closes through the loop, so it can forget the descriptor before the number is reused.
+    // Operations still pending on it complete with -ECANCELED first
+    Operation async_close(int fd) {
+        return make(Operation::Kind::Close, fd, nullptr, 0, -1);
+    }
+
+    // backend interface, implementations live in reactor.cpp
+    class Impl {
+    public:
+        virtual ~Impl() = default;
+        // start the operations, the ones that complete right away are added to `done`.
+        // Operations already expired complete with -ETIMEDOUT
+        virtual void submit(Operation* ops, ThreadPool::Task*& done) = 0;
+        // the deadline passed: marks the operation expired and completes it with -ETIMEDOUT
+        // if still pending, now or later. Finished or not yet submitted ones are left alone
+        virtual void cancel(Operation* op, ThreadPool::Task*& done) = 0;
+        // collect completions, blocks until at least one event if `block` is set
+        virtual void wait(ThreadPool::Task*& done, bool block) = 0;
+        // interrupt a blocking wait, any thread
+        virtual void wake() = 0;
+    };
+
+private:
+    Reactor(ThreadPool* pool, Sleeper* sleeper, Backend backend);
+
+    Operation make(Operation::Kind kind, int fd, void* buf, size_t len, int timeout_ms) {
+        if (timeout_ms >= 0 && sleeper_ == nullptr) throw std::logic_error("deadline on a reactor without a Sleeper");
+        return Operation(kind, fd, buf, len, this, timeout_ms);
+    }
+
+    void submit(Operation* op);
+    void expire(Operation* op);
+    static void loop(Reactor* reactor);
+
+    ThreadPool* pool_;
+    Sleeper* sleeper_ = nullptr;
+    Backend backend_;
+    std::unique_ptr<Impl> impl_;
+    std::mutex sync_;
+    Operation* pending_ = nullptr; // linked through next_
+    Operation* expired_ = nullptr; // linked through next_expired_
+    std::atomic_bool shutdown_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <coroutine>
+
+#include "threadpool.hpp"
+
+// co_await schedule(pool) - continue the coroutine on a pool worker.
+// The queue node lives in the awaiter, i.e. in the coroutine frame, so nothing is allocated
+struct ScheduleAwaiter {
+    ThreadPool* pool_;
+    ThreadPool::Task node_;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        node_.func_ = [h]{ h.resume(); };
+        pool_->run(&node_);
+    }
+    void await_resume() const noexcept {}
+};
+
+inline ScheduleAwaiter schedule(ThreadPool& pool) {
+    return ScheduleAwaiter{&pool, {}};
+}
@@ -2,57 +2,228 @@
 
 #include <iostream>
 #include <algorithm>
+#include <functional>
 
+int64_t Sleeper::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Covers the parked shards (all of them when shutting down)
 void Sleeper::worker(Sleeper* sleeper) {
+    std::unique_lock lk(sleeper->sync_);
     for(;;) {
-        {
-            const auto tp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            std::scoped_lock lock(sleeper->sync_);
-            while (!sleeper->queue_.empty() && sleeper->queue_.begin()->time_point_ < tp) {
-                auto it = sleeper->queue_.begin();
-                sleeper->pool_->run(std::move(it->func_));
-                sleeper->queue_.erase(it);
+        bool shutdown = sleeper->shutdown_.load();
+        bool empty = true;
+        int64_t next = TimingWheel::kNever;
+        ThreadPool::Task* batch = nullptr;
+        int64_t tp_now = now();
+        for (auto& shard: sleeper->shards_) {
+            std::scoped_lock shard_lock(shard->sync_);
+            if (shard->parked_ || shutdown) {
+                ThreadPool::Task* due = sleeper->drain(*shard, tp_now);
+                while (due != nullptr) {
+                    ThreadPool::Task* t = due;
+                    due = due->next_;
+                    t->next_ = batch;
+                    batch = t;
+                }
+                next = std::min(next, shard->queue_.next_deadline());
             }
-            if (sleeper->queue_.empty() && sleeper->shutdown_.load()) return;
+            empty = empty && shard->queue_.empty();
+        }
+        // hand everything due to the pool in one go, outside the lock
+        if (batch != nullptr) {
+            lk.unlock();
+            sleeper->pool_->run_batch(batch);
+            lk.lock();
+            continue; // time has passed
+        }
+        if (empty && shutdown) return;
+
+        // sleep until the next deadline, run() and park() wake us up earlier if needed
+        sleeper->next_wakeup_ = next;
+        if (next == TimingWheel::kNever) {
+            sleeper->waker_.wait(lk);
+        } else {
+            std::chrono::steady_clock::time_point tp{std::chrono::nanoseconds(next)};
+            sleeper->waker_.wait_until(lk, tp);
         }
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(100ms);
     }
 }
 
-Sleeper::Sleeper(ThreadPool* pool): pool_(pool) {
-    std::thread t(worker, this);   
-    this->worker_ = std::move(t); 
+Sleeper::Sleeper(ThreadPool* pool, bool sharded): pool_(pool), sharded_(sharded) {
+    size_t count = sharded ? pool->thread_count() : 1;
+    for (size_t i = 0; i < count; i++) {
+        shards_.push_back(std::make_unique<Shard>(now()));
+    }
+    if (sharded) pool_->set_poller(this);
+    std::thread t(worker, this);
+    this->worker_ = std::move(t);
 }
 
 Sleeper::~Sleeper() {
-    shutdown_.store(true);
+    if (sharded_) pool_->set_poller(nullptr);
+    {
+        std::scoped_lock lock(sync_);
+        shutdown_.store(true);
+    }
+    waker_.notify_one();
     worker_.join();
+    // fired closure timers hand their nodes back once the pool runs them
+    for (auto& shard: shards_) {
+        while (true) {
+            {
+                std::scoped_lock lock(shard->sync_);
+                if (shard->free_count_ == shard->pooled_.size()) break;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+// own shard on a worker, spread by thread id from outside
+size_t Sleeper::pick_shard() const {
+    if (shards_.size() == 1) return 0;
+    int index = pool_->worker_index();
+    if (index >= 0) return index;
+    return std::hash<std::thread::id>{}(std::this_thread::get_id()) % shards_.size();
 }
 
-void Sleeper::run(int ms, Closure func) {
+// called with shard.sync_ held, due timers linked through Task::next_
+ThreadPool::Task* Sleeper::drain(Shard& shard, int64_t now) {
+    ThreadPool::Task* batch = nullptr;
+    size_t count = 0;
+    TimingWheel::Node* due = shard.queue_.poll(now);
+    while (due != nullptr) {
+        auto* tp = static_cast<Timer*>(due);
+        due = due->next_;
+        tp->ThreadPool::Task::next_ = batch;
+        batch = tp;
+        count++;
+    }
+    shard.count_.fetch_sub(count, std::memory_order_relaxed);
+    shard.next_deadline_.store(shard.queue_.next_deadline(), std::memory_order_relaxed);
+    return batch;
+}
+
+// make the timer thread wake up by `deadline`
+void Sleeper::nudge(int64_t deadline) {
+    if (deadline == TimingWheel::kNever) return;
+    bool earlier;
     {
         std::scoped_lock lock(sync_);
-        queue_.emplace(ms, std::move(func));
+        earlier = deadline < next_wakeup_;
+        if (earlier) next_wakeup_ = deadline;
     }
+    if (earlier) waker_.notify_one();
 }
 
-std::atomic<int> Sleeper::TimePoint::counter;
+ThreadPool::Task* Sleeper::poll(size_t worker) {
+    Shard& shard = *shards_[worker];
+    if (shard.count_.load(std::memory_order_relaxed) == 0) return nullptr;
+    int64_t tp_now = now();
+    if (shard.next_deadline_.load(std::memory_order_relaxed) > tp_now) return nullptr;
+    std::scoped_lock lock(shard.sync_);
+    return drain(shard, tp_now);
+}
 
-Sleeper::TimePoint::TimePoint(int ms, Closure func) {
-    time_point_ = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() 
-                                                        + std::chrono::milliseconds(ms));
-    func_ = std::move(func);
-    id_ = counter.fetch_add(1);
+void Sleeper::park(size_t worker) {
+    Shard& shard = *shards_[worker];
+    int64_t deadline;
+    {
+        std::scoped_lock lock(shard.sync_);
+        shard.parked_ = true;
+        deadline = shard.queue_.next_deadline();
+    }
+    nudge(deadline);
 }
 
-bool Sleeper::TimePoint::operator<(const Sleeper::TimePoint& other) const {
-    if (time_point_ == other.time_point_) {
-        return id_ < other.id_;
+void Sleeper::unpark(size_t worker) {
+    Shard& shard = *shards_[worker];
+    std::scoped_lock lock(shard.sync_);
+    shard.parked_ = false;
+}
+
+// called with shard.sync_ held
+Sleeper::Handle Sleeper::insert(Shard& shard, size_t index, Timer* timer, int64_t deadline, bool& parked) {
+    timer->deadline_ = deadline;
+    timer->shard_ = index;
+    timer->seq_ = ++shard.seq_;
+    shard.queue_.insert(timer);
+    shard.count_.fetch_add(1, std::memory_order_relaxed);
+    if (deadline < shard.next_deadline_.load(std::memory_order_relaxed)) {
+        shard.next_deadline_.store(deadline, std::memory_order_relaxed);
+    }
+    parked = shard.parked_;
+    return Handle{timer, timer->seq_};
+}
+
+Sleeper::Handle Sleeper::run(int ms, Closure func) {
+    int64_t deadline = now() + ms * 1'000'000ll;
+    size_t index = pick_shard();
+    Shard& shard = *shards_[index];
+    Handle handle;
+    bool parked;
+    {
+        std::scoped_lock lock(shard.sync_);
+        PooledTimer* timer = shard.free_;
+        if (timer != nullptr) {
+            shard.free_ = static_cast<PooledTimer*>(timer->ThreadPool::Task::next_);
+            shard.free_count_--;
+        } else {
+            // grows to the most closure timers pending at once
+            shard.pooled_.push_back(std::make_unique<PooledTimer>(this));
+            timer = shard.pooled_.back().get();
+        }
+        timer->func_ = std::move(func);
+        timer->release_ = PooledTimer::recycle;
+        handle = insert(shard, index, timer, deadline, parked);
     }
-    return time_point_ < other.time_point_;
+    // shard locks are never held while taking sync_
+    if (parked) nudge(deadline);
+    return handle;
 }
 
-bool Sleeper::TimePoint::operator==(const Sleeper::TimePoint& other) const {
-    return this == &other;
-}
\ No newline at end of file
+Sleeper::Handle Sleeper::run(int ms, Timer* timer) {
+    int64_t deadline = now() + ms * 1'000'000ll;
+    size_t index = pick_shard();
+    Shard& shard = *shards_[index];
+    Handle handle;
+    bool parked;
+    {
+        std::scoped_lock lock(shard.sync_);
+        handle = insert(shard, index, timer, deadline, parked);
+    }
+    if (parked) nudge(deadline);
+    return handle;
+}
+
+bool Sleeper::cancel(Handle handle) {
+    Timer* timer = handle.timer_;
+    if (timer == nullptr) return false;
+    Shard& shard = *shards_[timer->shard_];
+    Closure func; // destroyed outside the lock
+    std::scoped_lock lock(shard.sync_);
+    // a recycled node was armed again since, with a newer seq_
+    if (timer->seq_ != handle.seq_ || !shard.queue_.remove(timer)) return false;
+    shard.count_.fetch_sub(1, std::memory_order_relaxed);
+    shard.next_deadline_.store(shard.queue_.next_deadline(), std::memory_order_relaxed);
+    if (timer->release_ == PooledTimer::recycle) {
+        func = std::move(timer->func_);
+        auto* pooled = static_cast<PooledTimer*>(timer);
+        pooled->ThreadPool::Task::next_ = shard.free_;
+        shard.free_ = pooled;
+        shard.free_count_++;
+    }
+    return true;
+}
+
+void Sleeper::PooledTimer::recycle(ThreadPool::Task* task) {
+    auto* timer = static_cast<PooledTimer*>(task);
+    Shard& shard = *timer->sleeper_->shards_[timer->shard_];
+    std::scoped_lock lock(shard.sync_);
+    timer->ThreadPool::Task::next_ = shard.free_;
+    shard.free_ = timer;
+    shard.free_count_++;
+}
@@ -1,34 +1,152 @@
 #pragma once
 
 #include <chrono>
-#include <set>
 #include <mutex>
 #include <condition_variable>
+#include <coroutine>
+#include <optional>
+#include <stop_token>
 
 #include "threadpool.hpp"
+#include "timingwheel.hpp"
+#include "cancel.hpp"
 
-class Sleeper {
+// Timers run on the pool.
+// Sharded (default): one timer shard per pool worker, armed by and drained from that worker's
+// scheduling loop, so concurrent run() calls don't share a lock. The timer thread only covers
+// shards of parked workers.
+// Unsharded: a single shard drained by the timer thread.
+class Sleeper : ThreadPool::Poller {
 public:
-    Sleeper(ThreadPool* pool);
+    Sleeper(ThreadPool* pool, bool sharded = true);
     ~Sleeper();
-    using Closure = std::function<void()>;
-    void run(int ms, Closure func);
-private:   
-    struct TimePoint {
-        int id_;
-        std::time_t time_point_;
-        Closure func_;
-        TimePoint(int ms, Closure func);
-        bool operator <(const TimePoint& other) const;
-        bool operator ==(const TimePoint& other) const;
-        static std::atomic<int> counter;
+    using Closure = ThreadPool::Closure;
+
+    // Wheel node and pool task in one. Nodes passed to run(ms, Timer*) are owned by the
+    // caller and can be embedded in awaiters, so arming a timer allocates nothing. The caller
+    // sets func_ (and release_ if it wants the node back after it fired) and keeps the node
+    // alive until it fired or was cancelled
+    struct Timer : ThreadPool::Task, TimingWheel::Node {
+        size_t shard_ = 0;
+        uint64_t seq_ = 0; // which arming of the node, guarded by the shard
+    };
+
+    // identifies an armed timer. For closure timers it stays valid (and harmless) after it
+    // fired, their nodes are recycled but live as long as the Sleeper. For caller owned
+    // nodes it is valid as long as the node
+    struct Handle {
+        Timer* timer_ = nullptr;
+        uint64_t seq_ = 0;
     };
-    
+
+    Handle run(int ms, Closure func);
+    Handle run(int ms, Timer* timer);
+    // true if the timer was still pending and won't fire, a caller owned node is free again
+    bool cancel(Handle handle);
+
+    // co_await sleeper.sleep(ms) -> true after `ms`, false if the awaiting task was
+    // cancelled first, which also cancels the timer
+    class SleepAwaiter;
+    SleepAwaiter sleep(int ms);
+
+    // steady clock in nanoseconds
+    static int64_t now();
+private:
+    // node of a closure timer, goes back to its shard's free list when the pool runs it
+    struct PooledTimer : Timer {
+        Sleeper* sleeper_;
+        explicit PooledTimer(Sleeper* sleeper): sleeper_(sleeper) {}
+        static void recycle(ThreadPool::Task* task);
+    };
+
+    struct alignas(64) Shard {
+        std::mutex sync_;
+        TimingWheel queue_;
+        uint64_t seq_ = 0;
+        // every closure timer node ever needed, the free ones linked through Task::next_
+        std::vector<std::unique_ptr<PooledTimer>> pooled_;
+        PooledTimer* free_ = nullptr;
+        size_t free_count_ = 0;
+        // lock free hints for the owner's poll
+        std::atomic<size_t> count_ = 0;
+        std::atomic<int64_t> next_deadline_ = TimingWheel::kNever;
+        // owner is asleep, the timer thread drains the shard
+        bool parked_ = true;
+        explicit Shard(int64_t now): queue_(now) {}
+    };
+
     ThreadPool* pool_;
-    std::set<TimePoint> queue_;
+    bool sharded_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    int64_t next_wakeup_ = TimingWheel::kNever;
     std::mutex sync_;
+    std::condition_variable waker_;
     std::thread worker_;
-    std::atomic_bool shutdown_;
+    std::atomic_bool shutdown_ = false;
+
+    size_t pick_shard() const;
+    Handle insert(Shard& shard, size_t index, Timer* timer, int64_t deadline, bool& parked);
+    ThreadPool::Task* drain(Shard& shard, int64_t now);
+    void nudge(int64_t deadline);
+
+    ThreadPool::Task* poll(size_t worker) override;
+    void park(size_t worker) override;
+    void unpark(size_t worker) override;
 
     static void worker(Sleeper* sleeper);
-};
\ No newline at end of file
+};
+
+class Sleeper::SleepAwaiter {
+public:
+    SleepAwaiter(Sleeper* sleeper, int ms): sleeper_(sleeper), ms_(ms) {}
+
+    bool await_ready() const noexcept { return ms_ <= 0; }
+
+    template<typename P>
+    bool await_suspend(std::coroutine_handle<P> h) {
+        std::stop_token stop = detail::stop_token_of(h);
+        if (stop.stop_requested()) {
+            fired_ = false;
+            return false;
+        }
+        h_ = h;
+        timer_.func_ = [this]{ resume(); };
+        handle_ = sleeper_->run(ms_, &timer_);
+        if (stop.stop_possible()) cancel_.emplace(std::move(stop), Cancel{this});
+        // the timer may already have fired, whoever comes second resumes
+        return refs_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    bool await_resume() const noexcept { return fired_; }
+
+private:
+    struct Cancel {
+        SleepAwaiter* awaiter_;
+        void operator()() const {
+            SleepAwaiter* a = awaiter_;
+            if (!a->sleeper_->cancel(a->handle_)) return; // fired already
+            a->fired_ = false;
+            // not inline, this runs inside somebody else's request_stop. The node is ours
+            // again and still resumes
+            a->sleeper_->pool_->run(&a->timer_);
+        }
+    };
+
+    void resume() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) h_.resume();
+    }
+
+    Sleeper* sleeper_;
+    int ms_;
+    bool fired_ = true;
+    Timer timer_;
+    Handle handle_;
+    std::coroutine_handle<> h_;
+    // the end of await_suspend and the timer (or its cancellation)
+    std::atomic<int> refs_ = 2;
+    std::optional<std::stop_callback<Cancel>> cancel_;
+};
+
+inline Sleeper::SleepAwaiter Sleeper::sleep(int ms) {
+    return SleepAwaiter(this, ms);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+#include "frameallocator.hpp"
+#include "cancel.hpp"
+
+// Lazily started coroutine with a result.
+// Nothing runs until the task is awaited, the awaiting coroutine is resumed by symmetric
+// transfer from final_suspend, so long await chains run inline without growing the stack
+// and without going through the pool.
+
+template<typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase : PooledFrame, Cancellable {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            if (auto c = h.promise().continuation_) return c;
+            return std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception_ = std::current_exception(); }
+
+    void rethrow() {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr exception_;
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase {
+    Task<T> get_return_object();
+    template<typename U>
+    void return_value(U&& value) { value_.emplace(std::forward<U>(value)); }
+    T result() {
+        rethrow();
+        return std::move(*value_);
+    }
+    std::optional<T> value_;
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() { rethrow(); }
+};
+
+}
+
+template<typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle h): h_(h) {}
+    Task(Task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(o.h_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (h_) h_.destroy();
+    }
+
+    struct Awaiter {
+        Handle h_;
+        bool await_ready() const noexcept { return !h_ || h_.done(); }
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> awaiting) noexcept {
+            h_.promise().continuation_ = awaiting;
+            if constexpr (std::is_base_of_v<detail::Cancellable, P>) {
+                // inherit cancellation, only pays for the copy when there is something to cancel
+                auto& stop = awaiting.promise().stop_;
+                if (stop.stop_possible() && !h_.promise().stop_.stop_possible()) h_.promise().stop_ = stop;
+            }
+            return h_; // start the task right away, no pool hop
+        }
+        T await_resume() { return h_.promise().result(); }
+    };
+
+    Awaiter operator co_await() const& noexcept { return Awaiter{h_}; }
+
+    bool done() const { return !h_ || h_.done(); }
+
+private:
+    Handle h_;
+};
+
+namespace detail {
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+// eagerly started, frees itself on completion
+struct Detached {
+    struct promise_type : PooledFrame {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+}
+
+// Starts the task on the calling thread and lets it finish on its own, exceptions terminate
+inline void spawn(Task<void> task) {
+    [](Task<void> t) -> detail::Detached {
+        co_await t;
+    }(std::move(task));
+}
+
+// Runs the task and blocks the calling thread until it finishes, the task may hop threads
+template<typename T>
+T sync_wait(Task<T> task) {
+    std::mutex sync;
+    std::condition_variable waker;
+    bool done = false;
+    std::exception_ptr exception;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> result;
+    auto wrapper = [&]() -> detail::Detached {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await task;
+            } else {
+                result.emplace(co_await task);
+            }
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        // notify under the lock, the waiter may destroy everything as soon as it returns
+        std::scoped_lock lock(sync);
+        done = true;
+        waker.notify_one();
+    };
+    wrapper();
+    {
+        std::unique_lock lk(sync);
+        waker.wait(lk, [&]{ return done; });
+    }
+    if (exception) std::rethrow_exception(exception);
+    if constexpr (!std::is_void_v<T>) return std::move(*result);
+}
@@ -1,49 +1,396 @@
 #include "threadpool.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
 
-void ThreadPool::worker(ThreadPool* pool) {
+#include <pthread.h>
+#include <sched.h>
+
+// how many tasks a worker grabs from the injection queue at once
+constexpr size_t kInjectionBatch = 32;
+
+thread_local ThreadPool* ThreadPool::current_pool_ = nullptr;
+thread_local size_t ThreadPool::current_index_ = 0;
+
+namespace {
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+std::vector<int> parse_cpulist(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int from = std::stoi(range.substr(0, dash));
+        int to = dash == std::string::npos ? from : std::stoi(range.substr(dash + 1));
+        for (int c = from; c <= to; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// cpus this process may run on
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+// cpus of every NUMA node that has some of `cpus`, a single node if sysfs has none
+std::vector<std::vector<int>> numa_nodes(const std::vector<int>& cpus) {
+    std::vector<std::vector<int>> nodes;
+    for (int n = 0;; n++) {
+        std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if (!f) break;
+        std::string list;
+        std::getline(f, list);
+        std::vector<int> node;
+        for (int c: parse_cpulist(list)) {
+            if (std::find(cpus.begin(), cpus.end(), c) != cpus.end()) node.push_back(c);
+        }
+        if (!node.empty()) nodes.push_back(std::move(node));
+    }
+    if (nodes.empty()) nodes.push_back(cpus);
+    return nodes;
+}
+
+void set_affinity(std::thread& t, const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c: cpus) CPU_SET(c, &set);
+    if (int err = pthread_setaffinity_np(t.native_handle(), sizeof(set), &set); err != 0) {
+        std::cerr << "pthread_setaffinity_np failed: " << err << std::endl;
+    }
+}
+
+}
+
+void ThreadPool::worker(ThreadPool* pool, size_t index) {
+    current_pool_ = pool;
+    current_index_ = index;
     for(;;) {
+        if (Task* ready = pool->poll(index); ready != nullptr) pool->run_batch(ready);
         std::unique_lock lk(pool->threads_sync_);
-        pool->task_waker_.wait(lk, [pool]{
-            return !pool->queue_.empty() || pool->shutdown_.load();
-        });
+        if (pool->queue_.empty() && !pool->shutdown_.load()) {
+            pool->park(index);
+            pool->task_waker_.wait(lk, [pool]{
+                return !pool->queue_.empty() || pool->shutdown_.load();
+            });
+            pool->unpark(index);
+        }
         if (pool->queue_.empty() && pool->shutdown_.load()) {
             lk.unlock();
             return;
         }
-        Task task = std::move(pool->queue_.front());
-        pool->queue_.pop_front();
+        Task* task = pool->queue_.pop_front();
         lk.unlock();
 
-        task.func_();
-        if (task.then_) task.then_();
+        execute(task);
     }
 }
 
-ThreadPool::ThreadPool() {
-    for (int i = 0; i < kThreadCount; i++) {
-        std::thread t(worker, this);
-        threads_.push_back(std::move(t));
+void ThreadPool::execute(Task* task) {
+    // the node may die as soon as the closure runs (e.g. it lives in a resumed coroutine frame)
+    Closure func = std::move(task->func_);
+    if (task->release_ != nullptr) task->release_(task);
+    func();
+}
+
+void ThreadPool::stealing_worker(ThreadPool* pool, size_t index) {
+    current_pool_ = pool;
+    current_index_ = index;
+    Group& group = *pool->groups_[pool->workers_[index]->group_];
+    for(;;) {
+        if (Task* ready = pool->poll(index); ready != nullptr) pool->push(ready, 0);
+        if (Task* task = pool->find_task(index); task != nullptr) {
+            execute(task);
+            continue;
+        }
+        // park: announce ourselves first, then check again so a concurrent push can't be missed
+        std::unique_lock lk(group.sync_);
+        group.sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!pool->has_work()) {
+            if (pool->shutdown_.load()) {
+                group.sleepers_.fetch_sub(1);
+                return;
+            }
+            pool->park(index);
+            group.waker_.wait(lk);
+            pool->unpark(index);
+        }
+        group.sleepers_.fetch_sub(1);
+    }
+}
+
+// own deque, own group, then other groups
+ThreadPool::Task* ThreadPool::find_task(size_t index) {
+    Worker& self = *workers_[index];
+    Task* task = nullptr;
+    if (self.deque_.pop(task)) return task;
+    if (task = take_injected(index, self.group_); task != nullptr) return task;
+    if (task = steal(index, true); task != nullptr) return task;
+    for (size_t g = 0; g < groups_.size(); g++) {
+        if (g == self.group_) continue;
+        if (task = take_injected(index, g); task != nullptr) return task;
+    }
+    return steal(index, false);
+}
+
+ThreadPool::Task* ThreadPool::take_injected(size_t index, size_t group_index) {
+    Group& group = *groups_[group_index];
+    if (group.injected_.load(std::memory_order_relaxed) == 0) return nullptr;
+    std::scoped_lock lock(group.sync_);
+    size_t count = std::min(group.injection_.size_, kInjectionBatch);
+    if (count == 0) return nullptr;
+    Task* task = group.injection_.pop_front();
+    // the rest goes to our deque, where idle workers can steal it
+    for (size_t i = 1; i < count; i++) {
+        workers_[index]->deque_.push(group.injection_.pop_front());
+    }
+    group.injected_.fetch_sub(count, std::memory_order_relaxed);
+    return task;
+}
+
+// random victim either from our group or from all the others
+ThreadPool::Task* ThreadPool::steal(size_t index, bool local) {
+    size_t n = workers_.size();
+    if (n < 2) return nullptr;
+    size_t group = workers_[index]->group_;
+    // xorshift64
+    uint64_t& x = workers_[index]->seed_;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    size_t start = x % n;
+    Task* task = nullptr;
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if (victim == index || (workers_[victim]->group_ == group) != local) continue;
+        if (workers_[victim]->deque_.steal(task)) return task;
+    }
+    return nullptr;
+}
+
+bool ThreadPool::has_work() {
+    for (auto& g: groups_) {
+        if (g->injected_.load() > 0) return true;
+    }
+    for (auto& w: workers_) {
+        if (!w->deque_.empty()) return true;
+    }
+    return false;
+}
+
+// group of the cpu the caller runs on
+size_t ThreadPool::submit_group() {
+    if (groups_.size() == 1) return 0;
+    int cpu = sched_getcpu();
+    if (cpu < 0 || (size_t) cpu >= cpu_group_.size()) return 0;
+    return cpu_group_[cpu];
+}
+
+ThreadPool::ThreadPool(): ThreadPool(Config()) {}
+
+ThreadPool::ThreadPool(Config config): mode_(config.mode) {
+    size_t thread_count = std::max<size_t>(1, config.threads);
+    std::vector<int> cpus = config.cpus.empty() ? allowed_cpus() : config.cpus;
+    bool numa = config.numa && mode_ == Mode::WorkStealing;
+    // cpu set for each worker, empty - no affinity
+    std::vector<std::vector<int>> affinity(thread_count);
+
+    for (size_t i = 0; i < thread_count; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_.back()->seed_ = 0x9E3779B97F4A7C15ull * (i + 1);
+        workers_.back()->group_ = 0;
+    }
+
+    if (mode_ == Mode::WorkStealing) {
+        auto nodes = numa ? numa_nodes(cpus) : std::vector<std::vector<int>>{cpus};
+        for (size_t n = 0; n < nodes.size() && n < thread_count; n++) {
+            groups_.push_back(std::make_unique<Group>());
+            for (int c: nodes[n]) {
+                if ((size_t) c >= cpu_group_.size()) cpu_group_.resize(c + 1, 0);
+                cpu_group_[c] = n;
+            }
+        }
+        // workers are spread round robin over the nodes
+        for (size_t i = 0; i < thread_count; i++) {
+            size_t g = i % groups_.size();
+            workers_[i]->group_ = g;
+            const auto& node = nodes[g];
+            size_t k = groups_[g]->workers_.size();
+            if (config.pin) {
+                affinity[i] = {node[k % node.size()]};
+            } else if (numa) {
+                affinity[i] = node;
+            }
+            groups_[g]->workers_.push_back(i);
+        }
+    } else if (config.pin) {
+        for (size_t i = 0; i < thread_count; i++) affinity[i] = {cpus[i % cpus.size()]};
+    }
+
+    for (size_t i = 0; i < thread_count; i++) {
+        if (mode_ == Mode::WorkStealing) {
+            threads_.emplace_back(stealing_worker, this, i);
+        } else {
+            threads_.emplace_back(worker, this, i);
+        }
+        if (!affinity[i].empty()) set_affinity(threads_.back(), affinity[i]);
     }
 }
 
 ThreadPool::~ThreadPool() {
-    shutdown_.store(true);
+    {
+        std::scoped_lock lock(threads_sync_);
+        shutdown_.store(true);
+    }
     task_waker_.notify_all();
+    for (auto& g: groups_) {
+        { std::scoped_lock lock(g->sync_); }
+        g->waker_.notify_all();
+    }
     for (auto& t: threads_) {
         t.join();
     }
 }
 
-void ThreadPool::run(Closure func, Closure then){
+// Workers flag themselves before touching the poller, so unsetting it can wait them out
+ThreadPool::Task* ThreadPool::poll(size_t index) {
+    if (poller_.load(std::memory_order_relaxed) == nullptr) return nullptr;
+    Worker& self = *workers_[index];
+    self.polling_.store(true);
+    Task* ready = nullptr;
+    if (Poller* poller = poller_.load(); poller != nullptr) ready = poller->poll(index);
+    self.polling_.store(false, std::memory_order_release);
+    return ready;
+}
+
+void ThreadPool::park(size_t index) {
+    if (poller_.load(std::memory_order_relaxed) == nullptr) return;
+    Worker& self = *workers_[index];
+    self.polling_.store(true);
+    if (Poller* poller = poller_.load(); poller != nullptr) poller->park(index);
+    self.polling_.store(false, std::memory_order_release);
+}
+
+void ThreadPool::unpark(size_t index) {
+    if (poller_.load(std::memory_order_relaxed) == nullptr) return;
+    Worker& self = *workers_[index];
+    self.polling_.store(true);
+    if (Poller* poller = poller_.load(); poller != nullptr) poller->unpark(index);
+    self.polling_.store(false, std::memory_order_release);
+}
+
+void ThreadPool::set_poller(Poller* poller) {
+    poller_.store(poller);
+    for (auto& w: workers_) {
+        while (w->polling_.load(std::memory_order_acquire)) std::this_thread::yield();
+    }
+}
+
+// wake up to `count` sleepers, starting with the group, the others would steal the tasks
+void ThreadPool::wake(size_t group, size_t count) {
+    for (size_t i = 0; i < groups_.size() && count > 0; i++) {
+        Group& g = *groups_[(group + i) % groups_.size()];
+        size_t sleepers = g.sleepers_.load();
+        if (sleepers == 0) continue;
+        // a parking worker holds the lock between its last check and the wait
+        { std::scoped_lock lock(g.sync_); }
+        if (count >= sleepers) {
+            g.waker_.notify_all();
+            count -= sleepers;
+        } else {
+            for (; count > 0; count--) g.waker_.notify_one();
+        }
+    }
+}
+
+// list linked through next_, count 0 - count it
+void ThreadPool::push(Task* head, size_t count, bool inject) {
+    if (count == 0) {
+        for (Task* t = head; t != nullptr; t = t->next_) count++;
+    }
+    size_t group;
+    if (current_pool_ == this && !inject) {
+        // LIFO push onto our own deque, no locks
+        Worker& self = *workers_[current_index_];
+        while (head != nullptr) {
+            Task* next = head->next_;
+            self.deque_.push(head);
+            head = next;
+        }
+        group = self.group_;
+    } else {
+        group = current_pool_ == this ? workers_[current_index_]->group_ : submit_group();
+        Group& g = *groups_[group];
+        std::scoped_lock lock(g.sync_);
+        while (head != nullptr) {
+            Task* next = head->next_;
+            g.injection_.push_back(head);
+            head = next;
+        }
+        g.injected_.fetch_add(count, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake(group, count);
+}
+
+void ThreadPool::run(Closure func, Closure then) {
+    Task* task = new Task;
+    if (then) {
+        task->func_ = [func = std::move(func), then = std::move(then)]() mutable {
+            func();
+            then();
+        };
+    } else {
+        task->func_ = std::move(func);
+    }
+    task->release_ = [](Task* t) { delete t; };
+    run(task);
+}
+
+void ThreadPool::run(Task* task) {
+    task->next_ = nullptr;
+    run_batch(task);
+}
+
+void ThreadPool::yield(Task* task) {
+    task->next_ = nullptr;
+    if (mode_ == Mode::WorkStealing) {
+        push(task, 1, true);
+        return;
+    }
+    run_batch(task);
+}
+
+void ThreadPool::run_batch(Task* head) {
+    size_t count = 0;
+    for (Task* t = head; t != nullptr; t = t->next_) count++;
+    if (count == 0) return;
+    if (mode_ == Mode::WorkStealing) {
+        push(head, count);
+        return;
+    }
     {
         std::scoped_lock lock(threads_sync_);
-        if (then) {
-            queue_.push_back({std::move(func), std::move(then)});
-        } else {
-            queue_.push_back({std::move(func), Closure()});
+        while (head != nullptr) {
+            Task* next = head->next_;
+            queue_.push_back(head);
+            head = next;
         }
     }
-    task_waker_.notify_one();
-}
\ No newline at end of file
+    if (count == 1) task_waker_.notify_one();
+    else task_waker_.notify_all();
+}
@@ -1,36 +1,151 @@
 #pragma once
 
-#include <functional>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
-#include <deque>
+#include <memory>
+#include <algorithm>
+
+#include "workstealing.hpp"
+#include "inplacetask.hpp"
 
 
 class ThreadPool {
 public:
-    using Closure = std::function<void()>;
-    constexpr static size_t kThreadCount = 2;
+    using Closure = InplaceTask;
+
+    // Intrusive queue node. Nodes passed to run(Task*) are owned by the caller and can be
+    // embedded in awaiters, so scheduling a resume allocates nothing.
+    // The pool moves func_ out before calling it, then hands the node to release_ if set,
+    // and never touches it afterwards.
+    struct Task {
+        Closure func_;
+        Task* next_ = nullptr;
+        void (*release_)(Task*) = nullptr;
+    };
+
+    enum class Mode {
+        Shared,       // one queue behind one mutex
+        WorkStealing  // deque per worker, injection queue per group for outside submissions
+    };
+
+    struct Config {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        Mode mode = Mode::Shared;
+        // pin worker i to a single cpu, from `cpus` or all online cpus when empty
+        bool pin = false;
+        std::vector<int> cpus = {};
+        // group workers per NUMA node with node-local injection queues (WorkStealing only).
+        // Workers are restricted to their node's cpus, tasks stay on the node they were
+        // submitted from and cross nodes only by stealing
+        bool numa = false;
+    };
+
+    // Hooks into every worker's scheduling loop, e.g. to run worker local timers.
+    // Called only from worker threads, with the worker's index
+    class Poller {
+    public:
+        virtual ~Poller() = default;
+        // between tasks, returns ready tasks linked through next_
+        virtual Task* poll(size_t worker) = 0;
+        // right before the worker sleeps for lack of work and right after it wakes up
+        virtual void park(size_t worker) = 0;
+        virtual void unpark(size_t worker) = 0;
+    };
 
     ThreadPool();
+    explicit ThreadPool(Config config);
     ~ThreadPool();
 
     void run(Closure func, Closure then = Closure());
+    void run(Task* task);
+    // schedules a list of tasks linked through next_ with one lock round trip
+    void run_batch(Task* head);
+    // like run(Task*), but queued behind what is already waiting: on a worker in
+    // WorkStealing mode it skips the LIFO deque and goes through the injection queue
+    void yield(Task* task);
+
+    size_t thread_count() const { return threads_.size(); }
+    // index of the calling worker thread, -1 if called from outside the pool
+    int worker_index() const { return current_pool_ == this ? current_index_ : -1; }
+
+    // at most one poller, set_poller(nullptr) returns once no worker is inside it anymore
+    void set_poller(Poller* poller);
 
 private:
-    struct Task {
-        Closure func_;
-        Closure then_;
+    // FIFO linked through Task::next_
+    struct TaskQueue {
+        Task* head_ = nullptr;
+        Task* tail_ = nullptr;
+        size_t size_ = 0;
+        bool empty() const { return head_ == nullptr; }
+        void push_back(Task* task) {
+            task->next_ = nullptr;
+            if (tail_ != nullptr) tail_->next_ = task;
+            else head_ = task;
+            tail_ = task;
+            size_++;
+        }
+        Task* pop_front() {
+            Task* task = head_;
+            head_ = task->next_;
+            if (head_ == nullptr) tail_ = nullptr;
+            size_--;
+            return task;
+        }
+    };
+
+    struct alignas(64) Worker {
+        ChaseLevDeque<Task*> deque_; // work stealing mode only
+        uint64_t seed_;
+        size_t group_;
+        std::atomic_bool polling_ = false;
+    };
+
+    // workers sharing an injection queue and a parking spot, one per NUMA node
+    struct alignas(64) Group {
+        std::mutex sync_;
+        std::condition_variable waker_;
+        TaskQueue injection_;
+        std::atomic<size_t> injected_ = 0;
+        std::atomic<size_t> sleepers_ = 0;
+        std::vector<size_t> workers_;
     };
 
-    std::deque<Task> queue_;
+    Mode mode_;
+    TaskQueue queue_;
     std::vector<std::thread> threads_;
     std::mutex threads_sync_;
     std::condition_variable task_waker_;
-    std::atomic_bool shutdown_;
+    std::atomic_bool shutdown_ = false;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<Poller*> poller_ = nullptr;
+
+    // work stealing mode
+    std::vector<std::unique_ptr<Group>> groups_;
+    std::vector<size_t> cpu_group_;
+
+    static thread_local ThreadPool* current_pool_;
+    static thread_local size_t current_index_;
+
+    // inject: through the injection queue even from a worker
+    void push(Task* head, size_t count, bool inject = false);
+    void wake(size_t group, size_t count);
+    Task* find_task(size_t index);
+    Task* take_injected(size_t index, size_t group);
+    Task* steal(size_t index, bool local);
+    bool has_work();
+    static void execute(Task* task);
+    size_t submit_group();
+
+    Task* poll(size_t index);
+    void park(size_t index);
+    void unpark(size_t index);
 
-    static void worker(ThreadPool* pool);
+    static void worker(ThreadPool* pool, size_t index);
+    static void stealing_worker(ThreadPool* pool, size_t index);
 };
 
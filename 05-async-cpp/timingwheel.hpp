@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+// Hierarchical hashed timing wheel with O(1) insert and cancel.
+// Level l has 64 slots of 64^l ticks each, 11 levels cover the whole 64 bit tick range.
+// A timer is stored on the lowest level where its tick shares all higher digits with
+// elapsed_, when elapsed_ reaches its slot it cascades down one or more levels.
+// Deadlines are kept in nanoseconds, ticks only decide the slot.
+class TimingWheel {
+public:
+    constexpr static int64_t kTickNs = 1'000'000; // 1ms
+    constexpr static int kLevels = 11;
+    constexpr static int kSlotBits = 6;
+    constexpr static int kSlots = 1 << kSlotBits;
+    constexpr static int64_t kNever = std::numeric_limits<int64_t>::max();
+
+    // intrusive node, owned by the caller
+    struct Node {
+        int64_t deadline_ = 0; // ns
+        Node* prev_ = nullptr;
+        Node* next_ = nullptr;
+        uint8_t level_ = 0;
+        uint8_t slot_ = 0;
+        bool linked_ = false;
+    };
+
+    explicit TimingWheel(int64_t now) : elapsed_(now / kTickNs) {}
+
+    bool empty() const { return count_ == 0; }
+    size_t size() const { return count_; }
+
+    void insert(Node* node) {
+        uint64_t tick = node->deadline_ / kTickNs;
+        if (tick < elapsed_) tick = elapsed_; // already late, fires on the next poll
+        int level = tick == elapsed_ ? 0 : (63 - __builtin_clzll(tick ^ elapsed_)) / kSlotBits;
+        int slot = (tick >> (level * kSlotBits)) & (kSlots - 1);
+        Node*& head = slots_[level][slot];
+        node->level_ = level;
+        node->slot_ = slot;
+        node->prev_ = nullptr;
+        node->next_ = head;
+        if (head != nullptr) head->prev_ = node;
+        head = node;
+        node->linked_ = true;
+        occupied_[level] |= 1ull << slot;
+        count_++;
+    }
+
+    // returns false if the node is not in the wheel (fired or never inserted)
+    bool remove(Node* node) {
+        if (!node->linked_) return false;
+        Node*& head = slots_[node->level_][node->slot_];
+        if (node->prev_ != nullptr) node->prev_->next_ = node->next_;
+        else head = node->next_;
+        if (node->next_ != nullptr) node->next_->prev_ = node->prev_;
+        if (head == nullptr) occupied_[node->level_] &= ~(1ull << node->slot_);
+        node->prev_ = node->next_ = nullptr;
+        node->linked_ = false;
+        count_--;
+        return true;
+    }
+
+    // Unlinks all timers with deadline <= now and returns them as a list through next_
+    Node* poll(int64_t now) {
+        uint64_t now_tick = now / kTickNs;
+        Node* due = nullptr;
+        int level;
+        uint64_t slot_tick;
+        while (next_slot(level, slot_tick) && slot_tick <= now_tick) {
+            int slot = (slot_tick >> (level * kSlotBits)) & (kSlots - 1);
+            Node* list = slots_[level][slot];
+            if (level == 0 && slot_tick == now_tick) {
+                // current tick - only what is due by the nanosecond
+                while (list != nullptr) {
+                    Node* next = list->next_;
+                    if (list->deadline_ <= now) {
+                        remove(list);
+                        list->next_ = due;
+                        due = list;
+                    }
+                    list = next;
+                }
+                break;
+            }
+            slots_[level][slot] = nullptr;
+            occupied_[level] &= ~(1ull << slot);
+            elapsed_ = slot_tick;
+            while (list != nullptr) {
+                Node* next = list->next_;
+                list->linked_ = false;
+                count_--;
+                if (level == 0) {
+                    list->next_ = due;
+                    due = list;
+                } else {
+                    insert(list); // cascade
+                }
+                list = next;
+            }
+        }
+        if (now_tick > elapsed_) elapsed_ = now_tick;
+        return due;
+    }
+
+    // When poll has something to do next: the earliest deadline or a cascade, kNever if empty
+    int64_t next_deadline() const {
+        int level;
+        uint64_t slot_tick;
+        if (!next_slot(level, slot_tick)) return kNever;
+        if (level > 0) return slot_tick * kTickNs;
+        int64_t deadline = kNever;
+        for (Node* n = slots_[0][slot_tick & (kSlots - 1)]; n != nullptr; n = n->next_) {
+            if (n->deadline_ < deadline) deadline = n->deadline_;
+        }
+        return deadline;
+    }
+
+private:
+    // first occupied slot, lower levels always expire before higher ones
+    bool next_slot(int& level, uint64_t& slot_tick) const {
+        for (level = 0; level < kLevels; level++) {
+            if (occupied_[level] == 0) continue;
+            int shift = level * kSlotBits;
+            int now_slot = (elapsed_ >> shift) & (kSlots - 1);
+            uint64_t rotated = (occupied_[level] >> now_slot)
+                             | (now_slot == 0 ? 0 : occupied_[level] << (kSlots - now_slot));
+            int slot = (now_slot + __builtin_ctzll(rotated)) & (kSlots - 1);
+            int range_shift = shift + kSlotBits;
+            uint64_t level_start = range_shift >= 64 ? 0 : elapsed_ & ~((1ull << range_shift) - 1);
+            slot_tick = level_start + ((uint64_t) slot << shift);
+            return true;
+        }
+        return false;
+    }
+
+    uint64_t elapsed_;
+    size_t count_ = 0;
+    uint64_t occupied_[kLevels] = {};
+    Node* slots_[kLevels][kSlots] = {};
+};
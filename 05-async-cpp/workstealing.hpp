@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// Chase-Lev work stealing deque
+// The owner pushes and pops at the bottom (LIFO), thieves steal from the top (FIFO).
+// Orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013)
+template<typename T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "deque stores raw values, use pointers");
+public:
+    explicit ChaseLevDeque(size_t capacity = 256) {
+        auto array = std::make_unique<Array>(capacity);
+        array_.store(array.get(), std::memory_order_relaxed);
+        arrays_.push_back(std::move(array));
+    }
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // owner only
+    void push(T value) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > (int64_t) a->capacity_ - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only
+    bool pop(T& out) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) { // empty
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        out = a->get(b);
+        if (t == b) { // last element - race against thieves
+            bool won = top_.compare_exchange_strong(t, t + 1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread
+    bool steal(T& out) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        Array* a = array_.load(std::memory_order_acquire);
+        T value = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false; // lost the race
+        }
+        out = value;
+        return true;
+    }
+
+    bool empty() const {
+        return bottom_.load(std::memory_order_seq_cst) <= top_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct Array {
+        explicit Array(size_t capacity)
+            : capacity_(capacity), data_(new std::atomic<T>[capacity]) {}
+        size_t capacity_;
+        std::unique_ptr<std::atomic<T>[]> data_;
+        T get(int64_t i) const {
+            return data_[i & (capacity_ - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T value) {
+            data_[i & (capacity_ - 1)].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    // thieves may still read the old array, so it is kept until the deque dies
+    Array* grow(Array* old, int64_t b, int64_t t) {
+        auto array = std::make_unique<Array>(old->capacity_ * 2);
+        for (int64_t i = t; i < b; i++) array->put(i, old->get(i));
+        Array* raw = array.get();
+        arrays_.push_back(std::move(array));
+        array_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    alignas(64) std::atomic<int64_t> top_ = 0;
+    alignas(64) std::atomic<int64_t> bottom_ = 0;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
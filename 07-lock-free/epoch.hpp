@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Epoch based reclamation (Fraser). A thread pins the global epoch while it touches shared
+// nodes. Retired nodes are tagged with the global epoch at retire time; the epoch only moves
+// on when every pinned thread has seen the current one, so two moves later nobody can
+// still hold a reference and the node is freed.
+// One process wide domain, any number of threads, each with its own limbo bags
+
+namespace epoch {
+
+struct Retired {
+    void* ptr_;
+    void (*deleter_)(void*);
+};
+
+struct Bag {
+    uint64_t epoch_ = 0;
+    std::vector<Retired> items_;
+
+    void free() {
+        for (auto& r: items_) r.deleter_(r.ptr_);
+        items_.clear();
+    }
+};
+
+constexpr uint64_t PINNED = 1;   // low bit of Record::local_, the epoch is shifted up by one
+constexpr int ADVANCE_EVERY = 64; // retires between attempts to move the epoch
+
+struct alignas(64) Record {
+    std::atomic<uint64_t> local_ = 0;
+    std::atomic<bool> in_use_ = true;
+    Record* next_ = nullptr;
+    // owner only
+    int nesting_ = 0;
+    int retired_ = 0;
+    Bag bags_[3]; // by epoch % 3
+};
+
+class Domain {
+public:
+    static Domain& instance() {
+        static Domain domain;
+        return domain;
+    }
+
+    ~Domain() {
+        // process exit, nobody is pinned anymore
+        Record* r = records_.load();
+        while (r != nullptr) {
+            Record* next = r->next_;
+            for (auto& bag: r->bags_) bag.free();
+            delete r;
+            r = next;
+        }
+        for (auto& bag: orphans_) bag.free();
+    }
+
+    void pin() {
+        Record* r = record();
+        if (r->nesting_++ > 0) return;
+        r->local_.store(global_.load(std::memory_order_relaxed) << 1 | PINNED, std::memory_order_relaxed);
+        // the pin is visible before any shared pointer is read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void unpin() {
+        Record* r = record();
+        if (--r->nesting_ > 0) return;
+        r->local_.store(0, std::memory_order_release);
+    }
+
+    template<typename T>
+    void retire(T* ptr) {
+        Record* r = record();
+        // read after the node was unlinked, anybody who could still see it is pinned at this
+        // epoch or an older one
+        uint64_t e = global_.load(std::memory_order_seq_cst);
+        Bag& bag = r->bags_[e % 3];
+        if (bag.epoch_ != e) {
+            bag.free(); // three or more epochs old
+            bag.epoch_ = e;
+        }
+        bag.items_.push_back(Retired{ptr, [](void* p) { delete static_cast<T*>(p); }});
+        if (++r->retired_ >= ADVANCE_EVERY) {
+            r->retired_ = 0;
+            try_advance();
+            free_expired(r);
+        }
+    }
+
+    // moves the epoch as far as pinned threads allow and frees what became safe.
+    // With no other thread pinned everything the caller and exited threads retired is freed
+    void collect() {
+        for (int i = 0; i < 3; i++) try_advance();
+        free_expired(record());
+    }
+
+private:
+    struct Handle {
+        Domain* domain_ = nullptr;
+        Record* record_ = nullptr;
+        ~Handle() {
+            if (record_ != nullptr) domain_->release(record_);
+        }
+    };
+
+    Record* record() {
+        thread_local Handle handle;
+        if (handle.record_ == nullptr) {
+            handle.domain_ = this;
+            handle.record_ = acquire();
+        }
+        return handle.record_;
+    }
+
+    // reuses a record of an exited thread or adds a new one, records are never unlinked
+    Record* acquire() {
+        for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next_) {
+            bool free = false;
+            if (!r->in_use_.load(std::memory_order_relaxed) &&
+                    r->in_use_.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record* r = new Record();
+        r->next_ = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(r->next_, r, std::memory_order_release)) {}
+        return r;
+    }
+
+    // the garbage outlives the thread, whoever collects next frees it
+    void release(Record* r) {
+        {
+            std::scoped_lock lock(orphans_sync_);
+            for (auto& bag: r->bags_) {
+                if (bag.items_.empty()) continue;
+                orphans_.push_back(std::move(bag));
+                bag = Bag{};
+            }
+            has_orphans_.store(!orphans_.empty(), std::memory_order_relaxed);
+        }
+        r->in_use_.store(false, std::memory_order_release);
+    }
+
+    bool try_advance() {
+        uint64_t e = global_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next_) {
+            uint64_t local = r->local_.load(std::memory_order_relaxed);
+            if ((local & PINNED) && (local >> 1) != e) return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return global_.compare_exchange_strong(e, e + 1, std::memory_order_release);
+    }
+
+    void free_expired(Record* r) {
+        uint64_t e = global_.load(std::memory_order_acquire);
+        for (auto& bag: r->bags_) {
+            if (bag.epoch_ + 2 <= e) bag.free();
+        }
+        if (!has_orphans_.load(std::memory_order_relaxed)) return;
+        std::unique_lock lock(orphans_sync_, std::try_to_lock);
+        if (!lock) return;
+        for (size_t i = 0; i < orphans_.size();) {
+            if (orphans_[i].epoch_ + 2 <= e) {
+                orphans_[i].free();
+                orphans_[i] = std::move(orphans_.back());
+                orphans_.pop_back();
+            } else {
+                i++;
+            }
+        }
+        has_orphans_.store(!orphans_.empty(), std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic<uint64_t> global_ = 0;
+    alignas(64) std::atomic<Record*> records_ = nullptr;
+    std::mutex orphans_sync_;
+    std::atomic<bool> has_orphans_ = false;
+    std::vector<Bag> orphans_;
+};
+
+}
+
+// Stack reclamation policy: a guard pins the epoch, protect is a plain load
+struct EpochReclaim {
+    class Guard {
+    public:
+        explicit Guard(EpochReclaim&) { epoch::Domain::instance().pin(); }
+        ~Guard() { epoch::Domain::instance().unpin(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        template<typename N>
+        N* protect(const std::atomic<N*>& src) { return src.load(); }
+    };
+
+    template<typename N>
+    void retire(N* ptr) { epoch::Domain::instance().retire(ptr); }
+
+    static void collect() { epoch::Domain::instance().collect(); }
+};
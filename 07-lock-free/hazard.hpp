@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Hazard pointers (Michael, P0233). A reader publishes the pointer it is about to use in one
+// of its slots and checks it is still reachable. Retired nodes wait in a per-thread list;
+// once that passes a threshold proportional to the number of hazards the thread snapshots
+// all published pointers, sorts them, and frees every retired node not in the snapshot.
+// One process wide domain, per-thread records in a lock-free list that only grows and
+// reuses the records of exited threads
+
+namespace hazard {
+
+constexpr int SLOTS = 4;          // per thread
+constexpr size_t MIN_BATCH = 64;  // retired nodes before a scan is worth it
+
+struct Retired {
+    void* ptr_;
+    void (*deleter_)(void*);
+};
+
+struct alignas(64) Record {
+    std::atomic<void*> hazards_[SLOTS] = {};
+    std::atomic<bool> in_use_ = true;
+    Record* next_ = nullptr;
+    // owner only
+    unsigned free_slots_ = (1u << SLOTS) - 1;
+    std::vector<Retired> retired_;
+    std::vector<void*> snapshot_; // kept to not allocate on every scan
+};
+
+class Domain {
+public:
+    static Domain& instance() {
+        static Domain domain;
+        return domain;
+    }
+
+    ~Domain() {
+        // process exit, nothing is protected anymore
+        Record* r = records_.load();
+        while (r != nullptr) {
+            Record* next = r->next_;
+            for (auto& d: r->retired_) d.deleter_(d.ptr_);
+            delete r;
+            r = next;
+        }
+        for (auto& d: orphans_) d.deleter_(d.ptr_);
+    }
+
+    std::atomic<void*>* acquire_slot() {
+        Record* r = record();
+        if (r->free_slots_ == 0) throw std::length_error("out of hazard slots");
+        int i = __builtin_ctz(r->free_slots_);
+        r->free_slots_ &= ~(1u << i);
+        return &r->hazards_[i];
+    }
+
+    void release_slot(std::atomic<void*>* slot) {
+        Record* r = record();
+        slot->store(nullptr, std::memory_order_release);
+        r->free_slots_ |= 1u << (slot - r->hazards_);
+    }
+
+    template<typename T>
+    void retire(T* ptr) {
+        Record* r = record();
+        r->retired_.push_back(Retired{ptr, [](void* p) { delete static_cast<T*>(p); }});
+        size_t threshold = std::max(MIN_BATCH, 2 * SLOTS * record_count_.load(std::memory_order_relaxed));
+        if (r->retired_.size() >= threshold) scan(r);
+    }
+
+    // frees whatever the caller and exited threads retired that isn't protected right now
+    void collect() {
+        scan(record());
+    }
+
+private:
+    struct Handle {
+        Domain* domain_ = nullptr;
+        Record* record_ = nullptr;
+        ~Handle() {
+            if (record_ != nullptr) domain_->release(record_);
+        }
+    };
+
+    Record* record() {
+        thread_local Handle handle;
+        if (handle.record_ == nullptr) {
+            handle.domain_ = this;
+            handle.record_ = acquire();
+        }
+        return handle.record_;
+    }
+
+    Record* acquire() {
+        for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next_) {
+            bool free = false;
+            if (!r->in_use_.load(std::memory_order_relaxed) &&
+                    r->in_use_.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record* r = new Record();
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        r->next_ = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(r->next_, r, std::memory_order_release)) {}
+        return r;
+    }
+
+    // what is still protected outlives the thread, whoever scans next frees it
+    void release(Record* r) {
+        scan(r);
+        if (!r->retired_.empty()) {
+            std::scoped_lock lock(orphans_sync_);
+            orphans_.insert(orphans_.end(), r->retired_.begin(), r->retired_.end());
+            has_orphans_.store(true, std::memory_order_relaxed);
+        }
+        r->retired_.clear();
+        r->free_slots_ = (1u << SLOTS) - 1;
+        r->in_use_.store(false, std::memory_order_release);
+    }
+
+    // frees the unprotected ones, keeps the rest in place
+    void reclaim(std::vector<Retired>& retired, const std::vector<void*>& snapshot) {
+        size_t kept = 0;
+        for (auto& d: retired) {
+            if (std::binary_search(snapshot.begin(), snapshot.end(), d.ptr_)) retired[kept++] = d;
+            else d.deleter_(d.ptr_);
+        }
+        retired.resize(kept);
+    }
+
+    void scan(Record* self) {
+        // the nodes were unlinked before, a hazard published after that fails its recheck
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto& snapshot = self->snapshot_;
+        snapshot.clear();
+        for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next_) {
+            for (auto& h: r->hazards_) {
+                void* p = h.load(std::memory_order_acquire);
+                if (p != nullptr) snapshot.push_back(p);
+            }
+        }
+        std::sort(snapshot.begin(), snapshot.end());
+        reclaim(self->retired_, snapshot);
+
+        if (!has_orphans_.load(std::memory_order_relaxed)) return;
+        std::unique_lock lock(orphans_sync_, std::try_to_lock);
+        if (!lock) return;
+        reclaim(orphans_, snapshot);
+        has_orphans_.store(!orphans_.empty(), std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic<Record*> records_ = nullptr;
+    std::atomic<size_t> record_count_ = 0;
+    std::mutex orphans_sync_;
+    std::atomic<bool> has_orphans_ = false;
+    std::vector<Retired> orphans_;
+};
+
+}
+
+// Stack reclamation policy: a guard owns one hazard slot
+struct HazardReclaim {
+    class Guard {
+    public:
+        explicit Guard(HazardReclaim&): slot_(hazard::Domain::instance().acquire_slot()) {}
+        ~Guard() { hazard::Domain::instance().release_slot(slot_); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        template<typename N>
+        N* protect(const std::atomic<N*>& src) {
+            N* ptr = src.load(std::memory_order_relaxed);
+            while (true) {
+                slot_->store(ptr);
+                N* again = src.load();
+                if (again == ptr) return ptr;
+                ptr = again;
+            }
+        }
+    private:
+        std::atomic<void*>* slot_;
+    };
+
+    template<typename N>
+    void retire(N* ptr) { hazard::Domain::instance().retire(ptr); }
+
+    static void collect() { hazard::Domain::instance().collect(); }
+};
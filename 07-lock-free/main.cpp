@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <iostream>
+#include <iomanip>
+#include <chrono>
 #include <thread>
 
 struct IntWrapper {
@@ -19,25 +21,90 @@ std::ostream& operator<<(std::ostream& os, const IntWrapper& w) {
     return os;
 }
 
-void test() {
+// every pushed value comes out exactly once, by a pop or when draining
+template<typename S>
+bool test() {
+    const int threads = 8, per_thread = 10'000;
     std::vector<std::thread> ts;
-    Stack<IntWrapper> stack;
-    for (int i = 0; i < 5; i++) {
+    std::atomic<long> popped = 0;
+    S stack;
+    for (int i = 0; i < threads; i++) {
         ts.emplace_back(std::thread([&] {
-            for (int j = 0; j < 10; j++) {
+            long sum = 0;
+            for (int j = 0; j < per_thread; j++) {
                 stack.push(j + 1);
-                stack.pop();
+                if (auto v = stack.pop()) sum += v->v;
             }
+            popped.fetch_add(sum);
         }));
     }
     for (auto& t: ts) {
         t.join();
     }
+    long sum = popped.load();
+    while (auto v = stack.pop()) sum += v->v;
+    return sum == long(threads) * per_thread * (per_thread + 1) / 2;
 }
 
-int main() {
-    test();
-    if (STACK_ALLOC_BALANCE.load() != 0) {
-        std::cout << "MEMORY LEAKED: " << STACK_ALLOC_BALANCE.load() << std::endl;
+// push/pop pairs per second of the whole stack
+template<typename S>
+double throughput(int threads, int pairs) {
+    S stack;
+    std::vector<std::thread> ts;
+    std::atomic<int> ready = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++) {
+        ts.emplace_back([&] {
+            ready.fetch_add(1);
+            while (ready.load() != threads) {}
+            for (int j = 0; j < pairs; j++) {
+                stack.push(j);
+                stack.pop();
+            }
+        });
     }
-}
\ No newline at end of file
+    for (auto& t: ts) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * pairs / seconds;
+}
+
+bool leaked() {
+    HazardReclaim::collect();
+    EpochReclaim::collect();
+    if (STACK_ALLOC_BALANCE.load() == 0) return false;
+    std::cout << "MEMORY LEAKED: " << STACK_ALLOC_BALANCE.load() << std::endl;
+    return true;
+}
+
+template<typename Reclaim>
+using Plain = Stack<IntWrapper, Reclaim, false, false>;
+template<typename Reclaim>
+using Cached = Stack<IntWrapper, Reclaim, false, true>;
+template<typename Reclaim>
+using Full = Stack<IntWrapper, Reclaim, true, true>;
+
+// usage: lockfree [push/pop pairs per thread]
+int main(int argc, char** argv) {
+    bool ok = test<Plain<HazardReclaim>>() && test<Full<HazardReclaim>>()
+           && test<Plain<EpochReclaim>>() && test<Full<EpochReclaim>>();
+    if (!ok) {
+        std::cout << "FAILED: lost or duplicated values" << std::endl;
+        return 1;
+    }
+    if (leaked()) return 1;
+
+    const int pairs = argc > 1 ? std::stoi(argv[1]) : 200'000;
+    std::cout << "Mops/s, +cache: per-thread node cache, +elim: elimination array" << std::endl;
+    std::cout << "threads  hazard  +cache  +elim   epoch  +cache  +elim" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int threads: {1, 2, 4, 8, 16, 32}) {
+        std::cout << std::setw(7) << threads
+                  << std::setw(8) << throughput<Plain<HazardReclaim>>(threads, pairs) / 1e6
+                  << std::setw(8) << throughput<Cached<HazardReclaim>>(threads, pairs) / 1e6
+                  << std::setw(7) << throughput<Full<HazardReclaim>>(threads, pairs) / 1e6
+                  << std::setw(8) << throughput<Plain<EpochReclaim>>(threads, pairs) / 1e6
+                  << std::setw(8) << throughput<Cached<EpochReclaim>>(threads, pairs) / 1e6
+                  << std::setw(7) << throughput<Full<EpochReclaim>>(threads, pairs) / 1e6 << std::endl;
+    }
+    if (leaked()) return 1;
+}
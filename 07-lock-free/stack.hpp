@@ -1,128 +1,76 @@
+#pragma once
+
 #include <atomic>
-#include <array>
-#include <optional>
 #include <functional>
+#include <optional>
 #include <thread>
+#include <type_traits>
 
-#include <iostream>
+#include "epoch.hpp"
+#include "hazard.hpp"
 
 std::atomic<int> STACK_ALLOC_BALANCE = 0;
 
 namespace {
 
-constexpr int HAZARD_N = 10;
-constexpr int HAZARD_R = 6;
-constexpr int HAZARD_T = 5;
+// Per-thread free list behind a node type's operator new/delete. Nodes come back only when
+// the reclamation policy deletes them, so a cached node is unreachable for other threads
+template<typename N>
+struct NodeCache {
+    static constexpr int CAPACITY = 256;
 
-struct hazard_ptr {
-    std::atomic<void*> memory_ = nullptr;
-    std::function<void(void*)> deleter_;
-    void clear() {
-        deleter_(memory_.load());
-        memory_.store(nullptr);
+    static void* operator new(size_t size) {
+        FreeList& list = list_;
+        if (list.head_ == nullptr) return ::operator new(size);
+        void* p = list.head_;
+        list.head_ = *static_cast<void**>(p);
+        list.size_--;
+        return p;
     }
-};
 
-struct dummy_hazard_context {
-    dummy_hazard_context() {
-        for (int i = 0; i < HAZARD_T; i++) ids_[i] = std::thread::id();
-        for (int t = 0; t < HAZARD_T; t++) {
-            for (int i = 0; i < HAZARD_N; i++) safe_[t][i] = nullptr;
-            for (int i = 0; i < HAZARD_R; i++) reclaim_[t][i].memory_ = nullptr;
-        }
-    }
-    ~dummy_hazard_context() {
-        for (int i = 0; i < HAZARD_T; i++) {
-            if (ids_[i] != std::thread::id()) {
-                hazard_scan(i);
-            }
-        }
-    }
-    int thread_id(std::thread::id id) {
-        for (int i = 0; i < HAZARD_T; i++) {
-            if (ids_[i].load() == id) return i;
-        }
-        // no id - create id
-        for (int i = 0; i < HAZARD_T; i++) {
-            std::thread::id empty_id;
-            if (ids_[i].compare_exchange_strong(empty_id, id)) {
-                return i;
-            }
-        }
-        std::cout << "##failed to store thread_id" << std::endl;
-        std::exit(-1); // failed to store thread id
-    }
-    void hazard_scan(int tid) {
-        // std::cout << "scanning! " << std::endl;
-        for (int di = 0; di < HAZARD_R; di++) {
-            void* needle = reclaim_[tid][di].memory_.load();
-            if (needle == nullptr) continue;
-            for (int otid = 0; otid < HAZARD_T; otid++) {
-                for (int i = 0; i < HAZARD_N; i++) {
-                    if (safe_[otid][i].load() == needle) goto SKIP;
-                }
-            }
-            // found something to delete - let's delete
-            reclaim_[tid][di].clear();
-            SKIP:;
-        }
-    }
-    template<typename T>
-    void hazard_delete(T* ptr) {
-        if (ptr == nullptr) return;
-        void* mem = (void*) ptr;
-        int tid = thread_id(std::this_thread::get_id());
-        for (int i = 0; i < HAZARD_R; i++) {
-            void* nullptr_v = nullptr;
-            if (reclaim_[tid][i].memory_.compare_exchange_strong(nullptr_v, mem)) {
-                reclaim_[tid][i].deleter_ = create_deleter(ptr);
-                return;
-            }
-        }
-        hazard_scan(tid); // failed to delete -> scan
-        hazard_delete(std::move(ptr)); // try again
-    }
-    template<typename T, typename D = std::default_delete<T>>
-    std::function<void(void*)> create_deleter(T* ptr) {
-        return [](void* mem){
-            D{}((T*) mem);
-        };
-    }
-    void hazard_safe(void* mem) {
-        if (mem == nullptr) return;
-        int tid = thread_id(std::this_thread::get_id());
-        for (int i = 0; i < HAZARD_N; i++) {
-            if (safe_[tid][i].load() == mem) return;
-        }
-        for (int i = 0; i < HAZARD_N; i++) {
-            void* nullptr_v = nullptr;
-            if (safe_[tid][i].compare_exchange_strong(nullptr_v, mem)) {
-                return;
-            }
+    static void operator delete(void* p) {
+        FreeList& list = list_;
+        if (list.closed_ || list.size_ >= CAPACITY) {
+            ::operator delete(p);
+            return;
         }
-        std::cout << "##failed to safe" << std::endl;
-        std::exit(-1);
+        drain_.touch();
+        *static_cast<void**>(p) = list.head_;
+        list.head_ = p;
+        list.size_++;
     }
-    void hazard_unsafe(void* mem) {
-        if (mem == nullptr) return;
-        int tid = thread_id(std::this_thread::get_id());
-        for (int i = 0; i < HAZARD_N; i++) {
-            void* mem_v = mem;
-            if (safe_[tid][i].compare_exchange_strong(mem_v, nullptr)) {
-                return;
+
+private:
+    // trivially destructible, so deletes from static destructors still find it
+    struct FreeList {
+        void* head_;
+        int size_;
+        bool closed_;
+    };
+    // frees the list when the thread exits
+    struct Drain {
+        void touch() {}
+        ~Drain() {
+            FreeList& list = list_;
+            while (list.head_ != nullptr) {
+                void* next = *static_cast<void**>(list.head_);
+                ::operator delete(list.head_);
+                list.head_ = next;
             }
+            list.size_ = 0;
+            list.closed_ = true;
         }
-    }
-    std::array<std::atomic<std::thread::id>, HAZARD_T> ids_;
-    std::atomic<void*> safe_[HAZARD_T][HAZARD_N];
-    hazard_ptr reclaim_[HAZARD_T][HAZARD_R];
+    };
+    static inline thread_local FreeList list_{};
+    static inline thread_local Drain drain_;
 };
 
+struct NoCache {};
 
-template<typename T>
-struct Node  {
+template<typename T, bool Cached>
+struct Node: std::conditional_t<Cached, NodeCache<Node<T, Cached>>, NoCache> {
     T value_;
-    Node<T>* next_;
+    Node* next_;
     Node(T&& value): value_(std::move(value)), next_(nullptr) {
         STACK_ALLOC_BALANCE.fetch_add(1);
     }
@@ -131,48 +79,117 @@ struct Node  {
     }
 };
 
+// Lets a push and a pop that both lost their CAS on the head cancel out. The pusher parks
+// its node in a random slot for a short while, a popper finding it there takes it.
+// A taken slot stays TAKEN until its pusher clears it, so no other node can show up in it
+// while the pusher still looks
+template<typename N>
+class EliminationArray {
+public:
+    static constexpr int SLOTS = 4;
+    static constexpr int WAIT = 128;
+
+    // true if a popper took the node
+    bool offer(N* node) {
+        auto& slot = slots_[index()].node_;
+        N* empty = nullptr;
+        if (!slot.compare_exchange_strong(empty, node, std::memory_order_release, std::memory_order_relaxed)) {
+            return false;
+        }
+        for (int i = 0; i < WAIT && slot.load(std::memory_order_relaxed) == node; i++) {
+            __builtin_ia32_pause();
+        }
+        N* mine = node;
+        if (slot.compare_exchange_strong(mine, nullptr, std::memory_order_relaxed)) return false;
+        slot.store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+
+    // a node nobody else can see anymore, or nullptr
+    N* take() {
+        auto& slot = slots_[index()].node_;
+        N* node = slot.load(std::memory_order_relaxed);
+        if (node == nullptr || node == taken()) return nullptr;
+        if (!slot.compare_exchange_strong(node, taken(), std::memory_order_acquire, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return node;
+    }
+
+private:
+    static N* taken() { return reinterpret_cast<N*>(uintptr_t(1)); }
+
+    static int index() {
+        thread_local unsigned x = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x % SLOTS;
+    }
+
+    struct alignas(64) Slot {
+        std::atomic<N*> node_ = nullptr;
+    };
+    Slot slots_[SLOTS];
 };
 
-template<typename T>
+};
+
+// Treiber stack. Reclaim decides when popped nodes are freed:
+//   Reclaim::Guard guard(reclaim) - covers one operation
+//   guard.protect(atomic)         - loads a pointer that stays valid while the guard lives
+//   reclaim.retire(node)          - deletes the unlinked node once nobody can reach it
+// Eliminate pairs up contending pushes and pops off the head, CacheNodes keeps freed nodes
+// in per-thread lists instead of going to malloc
+template<typename T, typename Reclaim = HazardReclaim, bool Eliminate = true, bool CacheNodes = true>
 class Stack {
+    using N = Node<T, CacheNodes>;
 public:
     void push(T&& value) {
-        auto node = new Node<T>(std::move(value));
+        // push never dereferences the head, nothing to protect
+        auto node = new N(std::move(value));
         node->next_ = head_.load();
-        context_.hazard_safe(node->next_);
-        Node<T>* real_v = nullptr;
-        while (!head_.compare_exchange_weak(real_v, node)) {
-            if (real_v != node->next_) {
-                context_.hazard_unsafe(node->next_);
-                node->next_ = real_v;
-                context_.hazard_safe(node->next_);
+        while (!head_.compare_exchange_weak(node->next_, node)) {
+            if constexpr (Eliminate) {
+                if (elimination_.offer(node)) return;
+                node->next_ = head_.load();
+            } else {
+                __builtin_ia32_pause();
             }
-            __builtin_ia32_pause();
         }
-        context_.hazard_unsafe(real_v);
     }
     std::optional<T> pop() {
+        typename Reclaim::Guard guard(reclaim_);
         while (true) {
-            Node<T>* top = head_.load();
+            N* top = guard.protect(head_);
             if (top == nullptr) return std::nullopt;
-            context_.hazard_safe(top);
             if (head_.compare_exchange_strong(top, top->next_)) {
                 T value = std::move(top->value_);
-                context_.hazard_delete(top);
-                context_.hazard_unsafe(top);
+                reclaim_.retire(top);
                 return value;
             }
+            if constexpr (Eliminate) {
+                // never was in the stack, no reclamation needed
+                if (N* node = elimination_.take()) {
+                    T value = std::move(node->value_);
+                    delete node;
+                    return value;
+                }
+            } else {
+                __builtin_ia32_pause();
+            }
         }
     }
     ~Stack() {
-        Node<T>* cur = head_.load();
+        N* cur = head_.load();
         while (cur != nullptr) {
-            Node<T>* next = cur->next_;
+            N* next = cur->next_;
             delete cur;
             cur = next;
         }
     }
 private:
-    dummy_hazard_context context_;
-    std::atomic<Node<T>*> head_ = nullptr;
-};
\ No newline at end of file
+    Reclaim reclaim_;
+    std::atomic<N*> head_ = nullptr;
+    EliminationArray<N> elimination_;
+};
@@ -0,0 +1,256 @@
+#include "runtime.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <algorithm>
+
+// mark: mark time for a long linked list, a complete binary tree and a random graph full
+// of cycles. Everything stays reachable, so every collection marks the whole shape.
+// alloc: allocation rate and pauses of a program that keeps replacing short lists while
+// holding a live set, 10 x objects allocations, collecting when four live sets were allocated.
+// parallel: STW pause of marking a random graph of objects/4, objects and 2 x objects nodes
+// with 1 to 8 marking threads.
+// concurrent: a mutator rewiring a graph of objects/4 nodes and replacing short lists, once
+// with stop the world collections and once with concurrent marking. Mutator throughput and
+// the longest pause, for concurrent marking both the snapshot and the remark count as pauses.
+// usage: bench [mark|alloc|parallel|concurrent|all] [objects]
+// build: g++ -std=c++17 -O2 bench.cpp ../05-async-cpp/threadpool.cpp -pthread
+
+struct ListNode : RefHolder {
+    Ref<ListNode> next;
+    auto refs() { return std::tie(next); }
+};
+
+struct TreeNode : RefHolder {
+    Ref<TreeNode> left, right;
+    auto refs() { return std::tie(left, right); }
+};
+
+struct GraphNode : RefHolder {
+    Ref<GraphNode> a, b;
+    auto refs() { return std::tie(a, b); }
+};
+
+// fields are set through RuntimeW, so nothing but the final Ref becomes a root
+RuntimeW<ListNode> make_list(size_t n) {
+    RuntimeW<ListNode> head{nullptr};
+    for (size_t i = 0; i < n; i++) {
+        auto node = RT.allocate<ListNode>();
+        node.ptr->next = head;
+        head = node;
+    }
+    return head;
+}
+
+RuntimeW<TreeNode> make_tree(int depth) {
+    auto node = RT.allocate<TreeNode>();
+    if (depth > 1) {
+        node.ptr->left = make_tree(depth - 1);
+        node.ptr->right = make_tree(depth - 1);
+    }
+    return node;
+}
+
+// a ring, so everything is reachable, plus one random edge per node
+RuntimeW<GraphNode> make_graph(size_t n) {
+    std::vector<RuntimeW<GraphNode>> nodes;
+    nodes.reserve(n);
+    for (size_t i = 0; i < n; i++) nodes.push_back(RT.allocate<GraphNode>());
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < n; i++) {
+        nodes[i].ptr->a = nodes[(i + 1) % n];
+        nodes[i].ptr->b = nodes[rng() % n];
+    }
+    return nodes[0];
+}
+
+template<typename T>
+void measure(const char* name, RuntimeW<T> shape) {
+    Ref<T> root = shape;
+    const int rounds = 5;
+    double best = 1e9, total = 0;
+    MarkStats stats;
+    for (int i = 0; i < rounds; i++) {
+        auto start = std::chrono::steady_clock::now();
+        stats = RT.collect();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ms);
+        total += ms;
+    }
+    std::cout << std::setw(6) << name
+              << std::setw(10) << stats.objects << " objects"
+              << std::setw(8) << stats.bytes / (1 << 20) << " MB"
+              << "  mark best " << std::setw(8) << best << "ms"
+              << "  avg " << std::setw(8) << total / rounds << "ms"
+              << "  " << std::setw(6) << stats.objects / best / 1e3 << " Mobj/s" << std::endl;
+}
+
+void measure_alloc(size_t n) {
+    const size_t lists = 1024, length = 64, live = lists * length;
+    const size_t budget = 4 * live;
+    std::vector<Ref<ListNode>> heads(lists);
+    // whatever earlier runs left behind is swept before the clock starts
+    RT.collect();
+    RT.collect();
+    std::vector<double> pauses;
+    std::mt19937_64 rng(42);
+    size_t allocated = 0, since_collect = 0, peak = 0;
+    double collecting = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (allocated < n) {
+        // the old list becomes garbage
+        RuntimeW<ListNode> list = make_list(length);
+        heads[rng() % lists] = list;
+        allocated += length;
+        since_collect += length;
+        if (since_collect >= budget) {
+            since_collect = 0;
+            auto pause_start = std::chrono::steady_clock::now();
+            RT.collect();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pause_start).count();
+            pauses.push_back(ms);
+            collecting += ms;
+            peak = std::max(peak, RT.heap_stats().committed);
+        }
+    }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::sort(pauses.begin(), pauses.end());
+    auto stats = RT.heap_stats();
+    peak = std::max(peak, stats.committed);
+    std::cout << "alloc  " << allocated << " objects, live set " << live << ", "
+              << pauses.size() << " collections" << std::endl
+              << "       " << allocated / (total - collecting) / 1e3 << " Mobj/s allocating, "
+              << allocated / total / 1e3 << " Mobj/s with collections" << std::endl;
+    // too few allocations for a collection
+    if (!pauses.empty()) {
+        std::cout << "       pause p50 " << pauses[pauses.size() / 2] << "ms  max " << pauses.back() << "ms" << std::endl;
+    }
+    std::cout << "       peak committed " << peak / (1 << 20) << " MB, now " << stats.pages << " pages in use, "
+              << stats.empty_pages << " empty" << std::endl;
+
+    // same sized objects from the general purpose allocator, no collector work at all
+    struct Plain {
+        char bytes[sizeof(ListNode)];
+    };
+    std::vector<Plain*> plain(lists * length, nullptr);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = rng() % plain.size();
+        delete plain[slot];
+        plain[slot] = new Plain();
+    }
+    total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (auto* p: plain) delete p;
+    std::cout << "       new/delete " << n / total / 1e3 << " Mobj/s" << std::endl;
+}
+
+void measure_parallel(size_t n) {
+    std::cout << "  heap objects  markers  pause ms  Mobj/s" << std::endl;
+    for (size_t size: {n / 4, n, 2 * n}) {
+        Ref<GraphNode> root = make_graph(size);
+        for (size_t threads: {1, 2, 4, 8}) {
+            std::unique_ptr<ThreadPool> pool;
+            if (threads > 1) {
+                ThreadPool::Config config;
+                config.threads = threads - 1; // the collecting thread marks too
+                pool = std::make_unique<ThreadPool>(config);
+            }
+            RT.set_mark_pool(pool.get());
+            double best = 1e9;
+            MarkStats stats;
+            for (int i = 0; i < 3; i++) {
+                auto start = std::chrono::steady_clock::now();
+                stats = RT.collect();
+                best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::cout << std::setw(14) << stats.objects << std::setw(9) << threads
+                      << std::setw(10) << best << std::setw(8) << stats.objects / best / 1e3 << std::endl;
+            RT.set_mark_pool(nullptr);
+        }
+    }
+}
+
+void measure_concurrent(size_t n, bool concurrent) {
+    const size_t lists = 1024, length = 64;
+    std::vector<Ref<ListNode>> heads(lists);
+    Ref<GraphNode> root = make_graph(n / 4);
+    // every node is on the ring through a, only b gets rewired
+    std::vector<GraphNode*> nodes;
+    GraphNode* node = root.get();
+    do {
+        nodes.push_back(node);
+        node = node->a.get();
+    } while (node != root.get());
+    RT.collect();
+    RT.collect();
+
+    const size_t budget = 4 * nodes.size();
+    std::vector<double> pauses;
+    std::mt19937_64 rng(42);
+    size_t ops = 0, since_collect = 0, cycles = 0;
+    auto timed = [&pauses](auto&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        pauses.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    };
+    auto start = std::chrono::steady_clock::now();
+    while (ops < 10 * n) {
+        heads[rng() % lists] = make_list(length);
+        for (size_t i = 0; i < length; i++) {
+            nodes[rng() % nodes.size()]->b = RuntimeW<GraphNode>{nodes[rng() % nodes.size()]};
+        }
+        ops += 2 * length;
+        since_collect += length;
+        if (RT.marking()) {
+            if (RT.concurrent_mark_done()) timed([] { RT.finish_concurrent_mark(); });
+        } else if (since_collect >= budget) {
+            since_collect = 0;
+            cycles++;
+            if (concurrent) timed([] { RT.start_concurrent_mark(); });
+            else timed([] { RT.collect(); });
+        }
+    }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // the mutator is done, the last cycle may finish tracing in peace
+    if (RT.marking()) {
+        while (!RT.concurrent_mark_done()) std::this_thread::yield();
+        timed([] { RT.finish_concurrent_mark(); });
+    }
+    std::sort(pauses.begin(), pauses.end());
+    std::cout << std::setw(10) << (concurrent ? "concurrent" : "stw")
+              << std::setw(8) << cycles << " cycles"
+              << "  mutator " << std::setw(6) << ops / total / 1e3 << " Mops/s"
+              << "  pause p50 " << std::setw(7) << pauses[pauses.size() / 2] << "ms"
+              << "  max " << std::setw(7) << pauses.back() << "ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "all";
+    size_t n = argc > 2 ? std::stoul(argv[2]) : 2'000'000;
+    // the smallest graph has objects / 4 nodes
+    if (n < 4) {
+        std::cerr << "usage: bench [mark|alloc|parallel|concurrent|all] [objects >= 4]" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    if (mode == "mark" || mode == "all") {
+        measure("list", make_list(n));
+        int depth = 1;
+        while ((size_t(2) << depth) - 1 <= n) depth++;
+        measure("tree", make_tree(depth));
+        measure("graph", make_graph(n));
+    }
+    if (mode == "alloc" || mode == "all") {
+        measure_alloc(n * 10);
+    }
+    if (mode == "parallel" || mode == "all") {
+        measure_parallel(n);
+    }
+    if (mode == "concurrent" || mode == "all") {
+        measure_concurrent(n, false);
+        measure_concurrent(n, true);
+    }
+}
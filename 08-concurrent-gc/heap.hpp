@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+// one per type, shared by all its objects
+struct TypeInfo {
+    void (*destroy)(void*);     // runs the object's destructor
+    uint32_t ref_count;         // fields holding references
+    const uint32_t* offsets;    // of those fields from the start of the object
+};
+
+// in front of every allocated object
+struct alignas(16) Header {
+    uint32_t mark;      // marked if equal to the runtime's current mark
+    uint32_t size;      // of the object without the header, 0 for a free cell
+    union {
+        const TypeInfo* type;
+        Header* next_free;  // free cells
+    };
+};
+
+inline Header* header_of(void* object) {
+    return static_cast<Header*>(object) - 1;
+}
+
+inline void* object_of(Header* h) {
+    return h + 1;
+}
+
+struct HeapStats {
+    size_t pages = 0;          // holding objects
+    size_t empty_pages = 0;    // returned to the OS, kept mapped for reuse
+    size_t large_objects = 0;
+    size_t committed = 0;      // bytes of pages and large objects
+};
+
+// Segregated size classes: a page holds cells of one size, handed out by bumping an index
+// and, once the page was swept, from its free list. After marking every page waits to be
+// swept; the allocator sweeps a page when it needs one, the next collection finishes what
+// is left. Pages without survivors go back to the OS with madvise and are reused by any
+// class. Objects too big for a class get their own allocation
+class Heap {
+public:
+    static constexpr size_t PAGE = 64 * 1024;
+    static constexpr size_t CHUNK = 64 * PAGE; // mapped at once
+    static constexpr size_t CLASSES[] = {32, 48, 64, 80, 96, 128, 160, 192, 256, 384, 512, 1024, 2048};
+    static constexpr int CLASS_COUNT = sizeof(CLASSES) / sizeof(size_t);
+
+    Heap() {
+        for (size_t size = 0, c = 0; size <= CLASSES[CLASS_COUNT - 1]; size += 16) {
+            while (CLASSES[c] < size) c++;
+            class_of_[size / 16] = c;
+        }
+    }
+
+    ~Heap() {
+        finish_sweep();
+        // everything left is live, process exit
+        for (auto& cls: classes_) {
+            for (Page* p: cls.swept_) {
+                for (size_t i = 0; i < p->bump_; i++) {
+                    Header* h = p->cell(i);
+                    if (h->size != 0) h->type->destroy(object_of(h));
+                }
+            }
+        }
+        for (Header* h: large_) {
+            if (h->size != 0) h->type->destroy(object_of(h));
+            ::operator delete(h, std::align_val_t(alignof(Header)));
+        }
+        for (void* chunk: chunks_) munmap(chunk, CHUNK);
+        for (Page* p: all_pages_) delete p;
+    }
+
+    // a header with the size set, the caller fills in the rest. Setting the size back to 0
+    // gives up the cell, the next sweep frees it
+    Header* allocate(size_t size, uint32_t mark) {
+        size_t cell = sizeof(Header) + size;
+        Header* h;
+        if (cell > CLASSES[CLASS_COUNT - 1]) {
+            h = static_cast<Header*>(::operator new(cell, std::align_val_t(alignof(Header))));
+            large_.push_back(h);
+        } else {
+            h = allocate_cell(class_of_[(cell + 15) / 16]);
+        }
+        h->mark = mark;
+        h->size = uint32_t(size);
+        return h;
+    }
+
+    // before marking: the old marks must be gone from every page
+    void finish_sweep() {
+        for (auto& cls: classes_) {
+            while (!cls.unswept_.empty()) {
+                Page* p = cls.unswept_.back();
+                cls.unswept_.pop_back();
+                if (sweep(p)) cls.swept_.push_back(p);
+            }
+        }
+    }
+
+    // after marking: cells not carrying `mark` are garbage
+    void start_sweep(uint32_t mark) {
+        mark_ = mark;
+        for (auto& cls: classes_) {
+            cls.current_ = nullptr;
+            cls.unswept_.swap(cls.swept_);
+        }
+        // large objects are swept right away, there are few of them
+        size_t kept = 0;
+        for (Header* h: large_) {
+            if (h->mark == mark_) {
+                large_[kept++] = h;
+            } else {
+                if (h->size != 0) h->type->destroy(object_of(h));
+                ::operator delete(h, std::align_val_t(alignof(Header)));
+            }
+        }
+        large_.resize(kept);
+    }
+
+    HeapStats stats() const {
+        HeapStats s;
+        for (auto& cls: classes_) s.pages += cls.swept_.size() + cls.unswept_.size();
+        s.empty_pages = empty_.size();
+        s.large_objects = large_.size();
+        s.committed = s.pages * PAGE;
+        for (Header* h: large_) s.committed += sizeof(Header) + h->size;
+        return s;
+    }
+
+private:
+    struct Page {
+        char* base_;
+        size_t cell_size_ = 0;
+        size_t capacity_ = 0;
+        size_t bump_ = 0;           // cells below were handed out at some point
+        Header* free_ = nullptr;
+
+        Header* cell(size_t i) { return reinterpret_cast<Header*>(base_ + i * cell_size_); }
+    };
+
+    struct SizeClass {
+        Page* current_ = nullptr;       // allocating from this one
+        std::vector<Page*> swept_;      // including current
+        std::vector<Page*> unswept_;
+    };
+
+    Header* allocate_cell(int c) {
+        SizeClass& cls = classes_[c];
+        while (true) {
+            if (Page* p = cls.current_) {
+                if (Header* h = p->free_) {
+                    p->free_ = h->next_free;
+                    return h;
+                }
+                if (p->bump_ < p->capacity_) return p->cell(p->bump_++);
+                cls.current_ = nullptr;
+            }
+            // lazy sweep, a page at a time
+            while (cls.current_ == nullptr && !cls.unswept_.empty()) {
+                Page* p = cls.unswept_.back();
+                cls.unswept_.pop_back();
+                if (!sweep(p)) continue;
+                cls.swept_.push_back(p);
+                if (p->free_ != nullptr || p->bump_ < p->capacity_) cls.current_ = p;
+            }
+            if (cls.current_ == nullptr) {
+                Page* p = empty_page();
+                p->cell_size_ = CLASSES[c];
+                p->capacity_ = PAGE / CLASSES[c];
+                cls.swept_.push_back(p);
+                cls.current_ = p;
+            }
+        }
+    }
+
+    // frees the dead cells, false if nothing survived and the page went back
+    bool sweep(Page* p) {
+        size_t live = 0;
+        p->free_ = nullptr;
+        for (size_t i = 0; i < p->bump_; i++) {
+            Header* h = p->cell(i);
+            if (h->size != 0) {
+                if (h->mark == mark_) {
+                    live++;
+                    continue;
+                }
+                h->type->destroy(object_of(h));
+                h->size = 0;
+            }
+            h->next_free = p->free_;
+            p->free_ = h;
+        }
+        if (live > 0) return true;
+        madvise(p->base_, PAGE, MADV_DONTNEED);
+        p->bump_ = 0;
+        p->free_ = nullptr;
+        empty_.push_back(p);
+        return false;
+    }
+
+    Page* empty_page() {
+        if (empty_.empty()) {
+            void* mem = mmap(nullptr, CHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) throw std::bad_alloc();
+            chunks_.push_back(mem);
+            for (size_t i = 0; i < CHUNK / PAGE; i++) {
+                Page* p = new Page{static_cast<char*>(mem) + i * PAGE};
+                all_pages_.push_back(p);
+                empty_.push_back(p);
+            }
+        }
+        Page* p = empty_.back();
+        empty_.pop_back();
+        return p;
+    }
+
+    SizeClass classes_[CLASS_COUNT];
+    uint8_t class_of_[CLASSES[CLASS_COUNT - 1] / 16 + 1];
+    uint32_t mark_ = 0;
+    std::vector<Page*> empty_;
+    std::vector<Header*> large_;
+    std::vector<void*> chunks_;
+    std::vector<Page*> all_pages_;
+};
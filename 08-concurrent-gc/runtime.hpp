@@ -0,0 +1,412 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <new>
+#include <stdexcept>
+
+#include <set>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include "heap.hpp"
+#include "../05-async-cpp/threadpool.hpp"
+#include "../05-async-cpp/workstealing.hpp"
+
+template<typename T>
+struct RuntimeW {
+    T* ptr;
+};
+
+// A reference is one word. References inside heap objects are found through the type's
+// offset table, any other reference is a root and carries a flag in the low bit
+struct RefBase {
+    static constexpr uintptr_t ROOT = 1;
+    uintptr_t bits_ = 0;
+
+    // the object this reference points to, nullptr if none. The tracer reads while the
+    // mutator writes
+    void* object() const {
+        return reinterpret_cast<void*>(__atomic_load_n(&bits_, __ATOMIC_ACQUIRE) & ~ROOT);
+    }
+};
+
+// base for structs that contain references, all of them listed by refs().
+// The runtime finds the fields by their address, so they can't be copied
+struct RefHolder {
+    RefHolder() = default;
+    RefHolder(const RefHolder& o) = delete;
+    RefHolder(RefHolder&& o) = delete;
+};
+
+// The number of reference fields is known from the type of refs(), their offsets are taken
+// from the first object of the type
+template<typename T>
+const TypeInfo* type_info(T* first) {
+    auto destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+    if constexpr(std::is_base_of_v<RefHolder, T>) {
+        using Refs = decltype(first->refs());
+        static const auto offsets = [first] {
+            std::array<uint32_t, std::tuple_size_v<Refs>> offsets{};
+            size_t i = 0;
+            std::apply([&](auto&... refs) {
+                static_assert((std::is_base_of_v<RefBase, std::decay_t<decltype(refs)>> && ...), "refs() lists Refs only");
+                ((offsets[i++] = uint32_t(reinterpret_cast<char*>(&refs) - reinterpret_cast<char*>(first))), ...);
+            }, first->refs());
+            return offsets;
+        }();
+        static const TypeInfo info{destroy, uint32_t(offsets.size()), offsets.data()};
+        return &info;
+    } else {
+        static const TypeInfo info{destroy, 0, nullptr};
+        return &info;
+    }
+}
+
+struct MarkStats {
+    size_t objects = 0;
+    size_t bytes = 0;
+};
+
+struct Runtime {
+    ~Runtime() {
+        if (tracer_.joinable()) tracer_.join();
+    }
+
+    // allocate object
+    template<typename T, typename... Args>
+    RuntimeW<T> allocate(Args&&... args) {
+        static_assert(alignof(T) <= alignof(Header));
+        // carries the current mark: survives this cycle's sweep, unmarked for the next collection
+        Header* header = heap_.allocate(sizeof(T), mark_);
+        char* object = static_cast<char*>(object_of(header));
+        // constructors may allocate too, or throw and leave the cell without a type
+        struct Guard {
+            Header* header_;
+            Constructing outer_;
+            ~Guard() {
+                constructing_ = outer_;
+                if (header_ != nullptr) header_->size = 0;
+            }
+        } guard{header, constructing_};
+        constructing_ = Constructing{object, object + sizeof(T), 0};
+        T* ptr = new (object) T(std::forward<Args>(args)...);
+        size_t fields = constructing_.refs_;
+        header->type = type_info(ptr);
+        guard.header_ = nullptr;
+        if (fields != header->type->ref_count) throw std::logic_error("Ref field missing from refs()");
+        return RuntimeW<T>{ptr};
+    }
+
+    // true for a root, false for a field of the object under construction
+    bool addRoot(RefBase* r) {
+        Constructing& c = constructing_;
+        char* p = reinterpret_cast<char*>(r);
+        if (p >= c.begin_ && p < c.end_) {
+            c.refs_++;
+            return false;
+        }
+        roots.insert(r);
+        return true;
+    }
+    void removeRoot(RefBase* r) {
+        roots.erase(r);
+    }
+
+    // marks everything reachable from the roots. The mark flips every collection, so
+    // marks never have to be cleared; the stack is explicit and reused, deep or cyclic
+    // graphs are fine. The dead are freed lazily, as the allocator needs their pages
+    MarkStats collect() {
+        if (marking()) return finish_concurrent_mark();
+        MarkStats stats;
+        heap_.finish_sweep();
+        mark_ ^= 1;
+        if (markers_.size() > 1) {
+            stats = parallel_mark();
+        } else {
+            for (RefBase* r: roots) push(r->object(), stats);
+            mark_from_stack(stats);
+        }
+        heap_.start_sweep(mark_);
+        return stats;
+    }
+
+    // Concurrent mode: the roots are pushed in a short pause and a background thread traces
+    // while the mutator keeps running. Objects allocated meanwhile carry the new mark already.
+    // Snapshot at the beginning (Yuasa): while marking, a Ref logs the object it overwrites,
+    // so everything reachable at the start gets marked even if the mutator unlinks it.
+    // finish_concurrent_mark drains the logs in a second pause and starts the sweep
+    void start_concurrent_mark() {
+        if (marking()) return;
+        heap_.finish_sweep();
+        mark_ ^= 1;
+        concurrent_stats_ = MarkStats{};
+        for (RefBase* r: roots) push(r->object(), concurrent_stats_);
+        traced_.store(false);
+        marking_.store(true);
+        tracer_ = std::thread([this] { trace(); });
+    }
+
+    // the background thread ran out of work, finishing now keeps the second pause short
+    bool concurrent_mark_done() const {
+        return traced_.load(std::memory_order_acquire);
+    }
+
+    // the mutators must be stopped, their logs are drained here
+    MarkStats finish_concurrent_mark() {
+        tracer_.join();
+        {
+            std::scoped_lock lock(satb_sync_);
+            for (SatbBuffer* buffer: satb_buffers_) {
+                satb_queue_.insert(satb_queue_.end(), buffer->entries_.begin(), buffer->entries_.end());
+                buffer->entries_.clear();
+            }
+        }
+        while (take_logged(concurrent_stats_)) mark_from_stack(concurrent_stats_);
+        marking_.store(false);
+        heap_.start_sweep(mark_);
+        return concurrent_stats_;
+    }
+
+    // write barrier
+    bool marking() const {
+        return marking_.load(std::memory_order_relaxed);
+    }
+
+    void log_overwritten(void* object) {
+        if (object == nullptr) return;
+        Header* h = header_of(object);
+        if (__atomic_load_n(&h->mark, __ATOMIC_RELAXED) == mark_) return;
+        SatbBuffer& buffer = satb_buffer_;
+        if (buffer.runtime_ == nullptr) {
+            buffer.runtime_ = this;
+            std::scoped_lock lock(satb_sync_);
+            satb_buffers_.push_back(&buffer);
+        }
+        buffer.entries_.push_back(h);
+        if (buffer.entries_.size() >= SATB_BATCH) flush(buffer);
+    }
+
+    // marks on every worker of the pool plus the collecting thread, nullptr to mark alone.
+    // The pool must be otherwise idle during collections, markers wait for each other
+    void set_mark_pool(ThreadPool* pool) {
+        pool_ = pool;
+        markers_.clear();
+        size_t count = pool == nullptr ? 1 : pool->thread_count() + 1;
+        for (size_t i = 0; i < count; i++) markers_.push_back(std::make_unique<Marker>());
+    }
+
+    HeapStats heap_stats() const {
+        return heap_.stats();
+    }
+
+private:
+    static constexpr size_t SATB_BATCH = 256; // logged objects a mutator keeps to itself
+
+    // the object being allocated, references inside it are fields
+    struct Constructing {
+        char* begin_ = nullptr;
+        char* end_ = nullptr;
+        size_t refs_ = 0;
+    };
+
+    // objects a mutator overwrote while marking, handed to the tracer in batches
+    struct SatbBuffer {
+        Runtime* runtime_ = nullptr;
+        std::vector<Header*> entries_;
+        ~SatbBuffer() {
+            if (runtime_ == nullptr) return;
+            runtime_->flush(*this);
+            std::scoped_lock lock(runtime_->satb_sync_);
+            auto& buffers = runtime_->satb_buffers_;
+            buffers.erase(std::find(buffers.begin(), buffers.end(), this));
+        }
+    };
+
+    void flush(SatbBuffer& buffer) {
+        std::scoped_lock lock(satb_sync_);
+        satb_queue_.insert(satb_queue_.end(), buffer.entries_.begin(), buffer.entries_.end());
+        buffer.entries_.clear();
+    }
+
+    // the background thread: the snapshot first, then whatever the mutators log
+    void trace() {
+        do {
+            mark_from_stack(concurrent_stats_);
+        } while (take_logged(concurrent_stats_));
+        traced_.store(true, std::memory_order_release);
+    }
+
+    // false if nothing was logged
+    bool take_logged(MarkStats& stats) {
+        {
+            std::scoped_lock lock(satb_sync_);
+            satb_work_.swap(satb_queue_);
+        }
+        if (satb_work_.empty()) return false;
+        for (Header* h: satb_work_) push(object_of(h), stats);
+        satb_work_.clear();
+        return true;
+    }
+
+    // calls f with the object every reference field of h points to
+    template<typename F>
+    static void for_each_field(Header* h, F&& f) {
+        const TypeInfo* type = h->type;
+        char* base = static_cast<char*>(object_of(h));
+        for (uint32_t i = 0; i < type->ref_count; i++) {
+            f(reinterpret_cast<RefBase*>(base + type->offsets[i])->object());
+        }
+    }
+
+    void mark_from_stack(MarkStats& stats) {
+        while (!mark_stack_.empty()) {
+            Header* h = mark_stack_.back();
+            mark_stack_.pop_back();
+            for_each_field(h, [this, &stats](void* object) { push(object, stats); });
+        }
+    }
+
+    struct alignas(64) Marker {
+        ChaseLevDeque<Header*> deque_{1024}; // grows once and keeps its size
+        MarkStats stats_;
+    };
+
+    // Roots are dealt out round robin, every marker drains its own deque and steals from the
+    // others when it runs dry. A marker counts as active while it may hold work, a thief
+    // becomes active before it steals, so nobody active and nothing to steal means done
+    MarkStats parallel_mark() {
+        size_t n = markers_.size();
+        size_t next = 0;
+        for (auto& m: markers_) m->stats_ = MarkStats{};
+        for (RefBase* r: roots) {
+            Marker& m = *markers_[next++ % n];
+            if (void* object = r->object(); object != nullptr && try_mark(header_of(object), m.stats_)) {
+                m.deque_.push(header_of(object));
+            }
+        }
+        active_.store(n);
+        finished_.store(0);
+        for (size_t i = 1; i < n; i++) {
+            pool_->run([this, i] {
+                drain(i);
+                finished_.fetch_add(1, std::memory_order_release);
+            });
+        }
+        drain(0);
+        while (finished_.load(std::memory_order_acquire) != n - 1) std::this_thread::yield();
+
+        MarkStats stats;
+        for (auto& m: markers_) {
+            stats.objects += m->stats_.objects;
+            stats.bytes += m->stats_.bytes;
+        }
+        return stats;
+    }
+
+    void drain(size_t index) {
+        Marker& self = *markers_[index];
+        size_t n = markers_.size();
+        Header* h;
+        while (true) {
+            while (self.deque_.pop(h)) scan(h, self);
+            active_.fetch_sub(1);
+            bool stolen = false;
+            while (!stolen) {
+                if (active_.load() == 0) return;
+                for (size_t i = 1; i < n && !stolen; i++) {
+                    Marker& victim = *markers_[(index + i) % n];
+                    if (victim.deque_.empty()) continue;
+                    active_.fetch_add(1);
+                    if (victim.deque_.steal(h)) stolen = true;
+                    else active_.fetch_sub(1);
+                }
+                if (!stolen) std::this_thread::yield();
+            }
+            scan(h, self);
+        }
+    }
+
+    void scan(Header* h, Marker& m) {
+        for_each_field(h, [this, &m](void* object) {
+            if (object != nullptr && try_mark(header_of(object), m.stats_)) {
+                m.deque_.push(header_of(object));
+            }
+        });
+    }
+
+    // only the thread flipping the mark gets to trace the object
+    bool try_mark(Header* h, MarkStats& stats) {
+        if (__atomic_load_n(&h->mark, __ATOMIC_RELAXED) == mark_) return false;
+        if (__atomic_exchange_n(&h->mark, mark_, __ATOMIC_RELAXED) == mark_) return false;
+        stats.objects++;
+        stats.bytes += h->size;
+        return true;
+    }
+
+    // one marking thread, but the write barrier reads the marks
+    void push(void* object, MarkStats& stats) {
+        if (object == nullptr) return;
+        Header* h = header_of(object);
+        if (__atomic_load_n(&h->mark, __ATOMIC_RELAXED) == mark_) return;
+        __atomic_store_n(&h->mark, mark_, __ATOMIC_RELAXED);
+        stats.objects++;
+        stats.bytes += h->size;
+        mark_stack_.push_back(h);
+    }
+
+    std::set<RefBase*> roots;
+    uint32_t mark_ = 0;
+    std::vector<Header*> mark_stack_;
+    Heap heap_;
+
+    ThreadPool* pool_ = nullptr;
+    std::vector<std::unique_ptr<Marker>> markers_;
+    std::atomic<size_t> active_ = 0;
+    std::atomic<size_t> finished_ = 0;
+
+    std::thread tracer_;
+    std::atomic<bool> marking_ = false;
+    std::atomic<bool> traced_ = false;
+    MarkStats concurrent_stats_;
+    std::mutex satb_sync_;
+    std::vector<SatbBuffer*> satb_buffers_;
+    std::vector<Header*> satb_queue_;
+    std::vector<Header*> satb_work_; // tracer only
+    static thread_local SatbBuffer satb_buffer_;
+    static thread_local Constructing constructing_;
+};
+
+inline thread_local Runtime::SatbBuffer Runtime::satb_buffer_;
+inline thread_local Runtime::Constructing Runtime::constructing_;
+
+inline Runtime RT;
+
+// references
+template<typename T>
+struct Ref : RefBase {
+    Ref() {
+        if (RT.addRoot(this)) bits_ = ROOT;
+    }
+    Ref(const Ref<T>& o) : Ref(RuntimeW<T>{o.get()}) {}
+    Ref(const Ref<T>&& o) = delete;
+    Ref(RuntimeW<T> w) : Ref() { *this = w; }
+    ~Ref() {
+        if (bits_ & ROOT) RT.removeRoot(this);
+    }
+    void operator=(const Ref<T>& o) { *this = RuntimeW<T>{o.get()}; }
+    void operator=(RuntimeW<T> w) {
+        // the tracer may still need the old object
+        if (RT.marking()) RT.log_overwritten(get());
+        __atomic_store_n(&bits_, reinterpret_cast<uintptr_t>(w.ptr) | (bits_ & ROOT), __ATOMIC_RELEASE);
+    }
+    T* get() const { return reinterpret_cast<T*>(bits_ & ~ROOT); }
+    T* operator->() { return get(); }
+};